@@ -13,7 +13,9 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <unistd.h>
 
+#include "parallel.h"
 #include "poly.h"
 #include "stack.h"
 #include "parser.h"
@@ -66,6 +68,16 @@ static void AtWrongValueError(size_t line_number) {
     fprintf(stderr, "ERROR %zu AT WRONG VALUE\n", line_number);
 }
 
+/**
+ * Wypisuje na standardowe wyjście błędów komunikat, że w poleceniu `EVAL`
+ * nie podano argumentów lub są one niepoprawne.
+ * Wypisuje, w której linii miał miejsce błąd.
+ * @param[in] line_number : numer linii, w której miał miejsce błą∂
+ */
+static void EvalWrongValueError(size_t line_number) {
+    fprintf(stderr, "ERROR %zu EVAL WRONG VALUE\n", line_number);
+}
+
 /**
  * Wypisuje na standardowe wyjście błędów komunikat, że w poleceniu `COMPOSE`
  * nie podano parametru lub jest on niepoprawny.
@@ -135,6 +147,46 @@ static bool ParseAtVal(char *s, char **endptr, poly_coeff_t *x) {
     return true;
 }
 
+/**
+ * Wczytuje argumenty polecenia `EVAL`: niepustą listę liczb oddzielonych
+ * pojedynczymi spacjami.
+ * @param[in] s : tablica znaków reprezentująca argumenty
+ * @param[in] endptr : adres wskaźnika, któremu po wczytaniu argumentów zostaje
+ * przypisany adres następnego znaku w tablicy po wczytanych argumentach
+ * @param[in] k : adres zmiennej typu `size_t`, której po poprawnym wczytaniu
+ * argumentów zostaje przypisana ich liczba
+ * @param[in] x : adres wskaźnika, któremu po poprawnym wczytaniu argumentów
+ * zostaje przypisana zaalokowana na stercie tablica ich wartości
+ * @return czy argumenty zostały wczytane poprawnie?
+ */
+static bool ParseEvalVals(char *s, char **endptr, size_t *k,
+                          poly_coeff_t **x) {
+    size_t x_size = 0;
+    size_t x_count = 0;
+    poly_coeff_t *vals = NULL;
+
+    do {
+        if (x_count == x_size) {
+            x_size = 1 + 2 * x_size;
+            poly_coeff_t *tmp_vals =
+                (poly_coeff_t*) realloc(vals, x_size * sizeof(poly_coeff_t));
+            if (tmp_vals == NULL) exit(1);
+            vals = tmp_vals;
+        }
+
+        if (!ParseAtVal(s, endptr, &vals[x_count])) {
+            free(vals);
+            return false;
+        }
+        x_count++;
+        s = *endptr + 1;
+    } while (**endptr == ' ');
+
+    *k = x_count;
+    *x = vals;
+    return true;
+}
+
 /**
  * Wczytuje argument polecenia `COMPOSE`.
  * @param[in] s : tablica znaków reprezentująca argument
@@ -291,6 +343,25 @@ static void ParseCommand(char *line, PolyStack *s, size_t line_number) {
         return;
     }
 
+    if (strncmp(line, "EVAL ", 5) == 0) {
+        size_t k;
+        poly_coeff_t *x;
+        char *endptr;
+        if (!ParseEvalVals(line + 5, &endptr, &k, &x)) {
+            EvalWrongValueError(line_number);
+            return;
+        }
+        if (*endptr != '\0') {
+            EvalWrongValueError(line_number);
+        } else if (IsEmpty(s)) {
+            UnderflowError(line_number);
+        } else {
+            Eval(s, k, x);
+        }
+        free(x);
+        return;
+    }
+
     if (strncmp(line, "COMPOSE ", 8) == 0) {
         size_t k;
         char *endptr;
@@ -320,24 +391,6 @@ static bool CommandHasInvalidChars(char *s, size_t len) {
     return false;
 }
 
-/**
- * Sprawdza, czy tablica znaków zawiera niedozwolone dla wielomianu znaki.
- * @param[in] s : tablica typu `char` reprezentująca wielomian
- * @param[in] len : lizcba znaków w tablicy `s`
- * @return czy linia zawiera znaki niedozwolone w wielomianie?
- */
-static bool PolyHasInvalidChars(char *s, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        if (isdigit(s[i]) == 0 &&
-            !(s[i] == '(' || s[i] == ')' || s[i] == ',' ||
-                s[i] == '+' || s[i] == '-' || s[i] == '0')
-        ) {
-            return true;
-        }
-    }
-    return false;
-}
-
 /**
  * Wczytuje linię, która może składać się z wielomianu lub polecenia.
  * @param[in] line : tablica typu `char` reprezentująca linię
@@ -359,21 +412,33 @@ static void ParseLine(char *line, PolyStack *stack, size_t line_number, size_t l
         return;
     }
 
-    if (PolyHasInvalidChars(line, len)) {
+    Poly p;
+    if (!ParsePolyLine(line, len, &p)) {
         WrongPolyError(line_number);
     } else {
-        char *endptr;
-        Poly p;
+        Push(stack, p);
+    }
+}
 
-        if (!ParsePoly(line, &endptr, &p)) {
-            WrongPolyError(line_number);
-        } else if (*endptr != '\0') {
-            PolyDestroy(&p);
-            WrongPolyError(line_number);
-        } else {
-            Push(stack, p);
+/**
+ * Ustawia liczbę wątków, na których wykonywane są obliczenia: wartość
+ * zmiennej środowiskowej `POLY_THREADS`, a jeśli nie jest ustawiona lub jest
+ * niepoprawna - liczbę dostępnych procesorów.
+ */
+static void InitThreads(void) {
+    const char *env = getenv("POLY_THREADS");
+    if (env != NULL && isdigit((unsigned char) env[0])) {
+        char *end;
+        errno = 0;
+        unsigned long count = strtoul(env, &end, 10);
+        if (errno == 0 && *end == '\0' && count > 0) {
+            PolySetThreads(count);
+            return;
         }
     }
+
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    PolySetThreads(count > 0 ? (size_t) count : 1);
 }
 
 /**
@@ -383,6 +448,7 @@ static void ParseLine(char *line, PolyStack *stack, size_t line_number, size_t l
 int main(void) {
     PolyStack stack;
     InitStack(&stack);
+    InitThreads();
 
     char *line = NULL;
     size_t line_len = 0;
@@ -0,0 +1,534 @@
+/** @file
+  Implementacja wielomianów w postaci rozłożonej.
+
+  Wyraz @f$c x_0^{e_0} \cdots x_{n-1}^{e_{n-1}}@f$ jest przechowywany jako
+  współczynnik i wektor wykładników spakowany w jedno lub dwa słowa
+  64-bitowe. Wszystkie pola mają tę samą szerokość, dobraną tak, aby
+  mieściły się w nich wykładniki wyniku operacji. Pole zmiennej 0 zajmuje
+  najstarsze bity pierwszego słowa, więc porządek słów (jako liczb bez znaku)
+  jest porządkiem leksykograficznym wektorów wykładników, takim samym jak
+  w rekurencyjnej reprezentacji wielomianów. Pola nie przekraczają granic
+  słów, a wykładniki są dobrane tak, że przy dodawaniu słów nie występują
+  przeniesienia między polami. Obliczenia na współczynnikach są wykonywane
+  na liczbach bez znaku, co daje te same wyniki modulo @f$2^{64}@f$ co
+  funkcje z pliku `poly.c`.
+
+  @authors Paweł Olejnik <po417770@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dist.h"
+
+/** Największa liczba słów w spakowanym wektorze wykładników. */
+#define DIST_MAX_WORDS 2
+
+/** Największa szerokość pola wykładnika; wykładniki są nieujemne. */
+#define DIST_MAX_BITS 31
+
+/**
+ * Sprawdza poprawną alokację pamięci.
+ * Jeśli pamięć nie została poprawnie zaalokowana, kończy program z kodem 1.
+ * @param p : wskaźnik na zaalokowaną pamięć
+ */
+static void CheckPtr(const void *p) {
+    if (p == NULL) exit(1);
+}
+
+/**
+ * Struktura przechowująca wielomian w postaci rozłożonej. Wyrazy są
+ * posortowane ściśle malejąco względem wektorów wykładników i mają niezerowe
+ * współczynniki.
+ */
+struct PolyDist {
+    size_t nvars;      ///< liczba zmiennych
+    unsigned bits;     ///< szerokość pola wykładnika jednej zmiennej
+    size_t words;      ///< liczba słów wektora wykładników jednego wyrazu
+    uint64_t max_exp;  ///< ograniczenie górne wykładników zmiennych
+    size_t size;       ///< liczba wyrazów
+    size_t capacity;   ///< rozmiar zaalokowanych tablic (w wyrazach)
+    uint64_t *coeffs;  ///< współczynniki wyrazów
+    uint64_t *exps;    ///< wektory wykładników, po `words` słów na wyraz
+};
+
+/**
+ * Dobiera szerokość pól i liczbę słów wektora wykładników.
+ * @param[in] nvars : liczba zmiennych
+ * @param[in] max_exp : największy wykładnik, który musi się zmieścić w polu
+ * @param[out] bits : szerokość pola
+ * @param[out] words : liczba słów
+ * @return czy wykładniki mieszczą się w `DIST_MAX_WORDS` słowach?
+ */
+static bool ChooseLayout(size_t nvars, uint64_t max_exp,
+                         unsigned *bits, size_t *words) {
+    unsigned b = 1;
+    while (b < 64 && (max_exp >> b) != 0) b++;
+    if (b > DIST_MAX_BITS) return false;
+
+    size_t per_word = 64 / b;
+    size_t w = nvars == 0 ? 1 : (nvars + per_word - 1) / per_word;
+    if (w > DIST_MAX_WORDS) return false;
+
+    *bits = b;
+    *words = w;
+    return true;
+}
+
+/**
+ * Wyznacza położenie pola wykładnika zmiennej w wektorze wykładników.
+ * @param[in] var : indeks zmiennej
+ * @param[in] bits : szerokość pola
+ * @param[out] word : indeks słowa zawierającego pole
+ * @param[out] shift : przesunięcie pola w słowie
+ */
+static inline void FieldPos(size_t var, unsigned bits,
+                            size_t *word, unsigned *shift) {
+    size_t per_word = 64 / bits;
+    *word = var / per_word;
+    *shift = 64 - bits * (unsigned) (var % per_word + 1);
+}
+
+/**
+ * Odczytuje wykładnik zmiennej z wektora wykładników.
+ * @param[in] exps : wektor wykładników
+ * @param[in] var : indeks zmiennej
+ * @param[in] bits : szerokość pola
+ * @return wykładnik zmiennej
+ */
+static inline uint64_t GetField(const uint64_t *exps, size_t var,
+                                unsigned bits) {
+    size_t word;
+    unsigned shift;
+    FieldPos(var, bits, &word, &shift);
+    return (exps[word] >> shift) & ((UINT64_C(1) << bits) - 1);
+}
+
+/**
+ * Porównuje wektory wykładników.
+ * @param[in] a : wektor @f$a@f$
+ * @param[in] b : wektor @f$b@f$
+ * @param[in] words : liczba słów wektorów
+ * @return -1 jeśli @f$a<b@f$, 0 jeśli @f$a=b@f$, 1 jeśli @f$a>b@f$
+ */
+static inline int CompareExps(const uint64_t *a, const uint64_t *b,
+                              size_t words) {
+    for (size_t w = 0; w < words; w++) {
+        if (a[w] != b[w]) return a[w] < b[w] ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * Zmienia rozmiar tablic wyrazów wielomianu.
+ * @param[in,out] d : wielomian w postaci rozłożonej
+ * @param[in] capacity : nowy rozmiar tablic, nie mniejszy niż liczba wyrazów
+ */
+static void DistReserve(PolyDist *d, size_t capacity) {
+    if (capacity == 0) capacity = 1;
+    d->coeffs = (uint64_t*) realloc(d->coeffs, capacity * sizeof(uint64_t));
+    CheckPtr(d->coeffs);
+    d->exps = (uint64_t*) realloc(d->exps,
+                                  capacity * d->words * sizeof(uint64_t));
+    CheckPtr(d->exps);
+    d->capacity = capacity;
+}
+
+/**
+ * Tworzy wielomian w postaci rozłożonej bez wyrazów.
+ * @param[in] nvars : liczba zmiennych
+ * @param[in] bits : szerokość pola wykładnika
+ * @param[in] words : liczba słów wektora wykładników
+ * @param[in] max_exp : ograniczenie górne wykładników
+ * @param[in] capacity : początkowy rozmiar tablic wyrazów
+ * @return wielomian w postaci rozłożonej
+ */
+static PolyDist *DistCreate(size_t nvars, unsigned bits, size_t words,
+                            uint64_t max_exp, size_t capacity) {
+    PolyDist *d = (PolyDist*) calloc(1, sizeof(PolyDist));
+    CheckPtr(d);
+    d->nvars = nvars;
+    d->bits = bits;
+    d->words = words;
+    d->max_exp = max_exp;
+    DistReserve(d, capacity);
+    return d;
+}
+
+/**
+ * Dopisuje wyraz na koniec listy wyrazów wielomianu, w razie potrzeby
+ * powiększając tablice. Wyrazy o zerowym współczynniku są pomijane.
+ * @param[in,out] d : wielomian w postaci rozłożonej
+ * @param[in] coeff : współczynnik wyrazu
+ * @param[in] exps : wektor wykładników wyrazu
+ */
+static void DistAppend(PolyDist *d, uint64_t coeff, const uint64_t *exps) {
+    if (coeff == 0) return;
+    if (d->size == d->capacity) DistReserve(d, 1 + 2 * d->capacity);
+
+    d->coeffs[d->size] = coeff;
+    memcpy(&d->exps[d->size * d->words], exps, d->words * sizeof(uint64_t));
+    d->size++;
+}
+
+/**
+ * Daje wektory wykładników wyrazów wielomianu w zadanym układzie pól. Układ
+ * musi mieścić co najmniej `d->nvars` zmiennych i wykładniki `d->max_exp`.
+ * @param[in] d : wielomian w postaci rozłożonej
+ * @param[in] bits : szerokość pola
+ * @param[in] words : liczba słów wektora wykładników
+ * @return wektory wykładników; jeśli są różne od `d->exps`, to należy je
+ * zwolnić funkcją `free`
+ */
+static uint64_t *ExpsInLayout(const PolyDist *d, unsigned bits,
+                              size_t words) {
+    if (bits == d->bits && words == d->words) return d->exps;
+
+    uint64_t *res = (uint64_t*) calloc(d->size * words + 1, sizeof(uint64_t));
+    CheckPtr(res);
+
+    for (size_t t = 0; t < d->size; t++) {
+        for (size_t var = 0; var < d->nvars; var++) {
+            uint64_t e = GetField(&d->exps[t * d->words], var, d->bits);
+            size_t word;
+            unsigned shift;
+            FieldPos(var, bits, &word, &shift);
+            res[t * words + word] |= e << shift;
+        }
+    }
+
+    return res;
+}
+
+/**
+ * Wyznacza liczbę zmiennych, największy wykładnik i liczbę wyrazów
+ * wielomianu.
+ * @param[in] p : wielomian
+ * @param[in] depth : liczba zmiennych, po których już zeszliśmy
+ * @param[in,out] nvars : liczba zmiennych
+ * @param[in,out] max_exp : największy wykładnik
+ * @param[in,out] size : liczba wyrazów
+ */
+static void MeasurePoly(const Poly *p, size_t depth, size_t *nvars,
+                        uint64_t *max_exp, size_t *size) {
+    if (PolyIsCoeff(p)) {
+        if (!PolyIsZero(p)) {
+            (*size)++;
+            if (depth > *nvars) *nvars = depth;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < p->size; i++) {
+        uint64_t exp = (uint64_t) MonoGetExp(&p->arr[i]);
+        if (exp > *max_exp) *max_exp = exp;
+        MeasurePoly(&p->arr[i].p, depth + 1, nvars, max_exp, size);
+    }
+}
+
+/**
+ * Dopisuje wyrazy wielomianu do wielomianu w postaci rozłożonej. Jednomiany
+ * są posortowane malejąco, więc wyrazy są dopisywane we właściwej kolejności.
+ * @param[in] p : wielomian
+ * @param[in] var : indeks zmiennej wielomianu @p p
+ * @param[in,out] path : wektor wykładników zmiennych o indeksach mniejszych
+ * niż @p var
+ * @param[in,out] d : wielomian w postaci rozłożonej
+ */
+static void FlattenPoly(const Poly *p, size_t var, uint64_t *path,
+                        PolyDist *d) {
+    if (PolyIsCoeff(p)) {
+        DistAppend(d, (uint64_t) p->coeff, path);
+        return;
+    }
+
+    size_t word;
+    unsigned shift;
+    FieldPos(var, d->bits, &word, &shift);
+
+    for (size_t i = 0; i < p->size; i++) {
+        uint64_t exp = (uint64_t) MonoGetExp(&p->arr[i]);
+        path[word] |= exp << shift;
+        FlattenPoly(&p->arr[i].p, var + 1, path, d);
+        path[word] &= ~(exp << shift);
+    }
+}
+
+PolyDist *PolyDistFromPoly(const Poly *p) {
+    size_t nvars = 0, size = 0;
+    uint64_t max_exp = 0;
+    MeasurePoly(p, 0, &nvars, &max_exp, &size);
+
+    unsigned bits;
+    size_t words;
+    if (!ChooseLayout(nvars, max_exp, &bits, &words)) return NULL;
+
+    PolyDist *d = DistCreate(nvars, bits, words, max_exp, size);
+    uint64_t path[DIST_MAX_WORDS] = {0};
+    FlattenPoly(p, 0, path, d);
+    return d;
+}
+
+/**
+ * Tworzy wielomian ze spójnego fragmentu listy wyrazów, w którym wszystkie
+ * wyrazy mają te same wykładniki zmiennych o indeksach mniejszych niż
+ * @p var .
+ * @param[in] d : wielomian w postaci rozłożonej
+ * @param[in] lo : indeks pierwszego wyrazu fragmentu
+ * @param[in] hi : indeks za ostatnim wyrazem fragmentu
+ * @param[in] var : indeks zmiennej tworzonego wielomianu
+ * @return wielomian będący sumą wyrazów fragmentu podzielonych przez
+ * wspólne potęgi zmiennych o indeksach mniejszych niż @p var
+ */
+static Poly BuildPoly(const PolyDist *d, size_t lo, size_t hi, size_t var) {
+    if (var == d->nvars) {
+        return PolyFromCoeff((poly_coeff_t) d->coeffs[lo]);
+    }
+
+    Mono *monos = (Mono*) calloc(hi - lo, sizeof(Mono));
+    CheckPtr(monos);
+
+    size_t count = 0;
+    size_t i = lo;
+    while (i < hi) {
+        uint64_t exp = GetField(&d->exps[i * d->words], var, d->bits);
+        size_t j = i + 1;
+        while (j < hi &&
+               GetField(&d->exps[j * d->words], var, d->bits) == exp) {
+            j++;
+        }
+        monos[count++] = (Mono) {
+            .p = BuildPoly(d, i, j, var + 1),
+            .exp = (poly_exp_t) exp
+        };
+        i = j;
+    }
+
+    Poly res = PolyAddMonos(count, monos);
+    free(monos);
+    return res;
+}
+
+Poly PolyDistToPoly(const PolyDist *d) {
+    if (d->size == 0) return PolyZero();
+    return BuildPoly(d, 0, d->size, 0);
+}
+
+void PolyDistDestroy(PolyDist *d) {
+    if (d == NULL) return;
+    free(d->coeffs);
+    free(d->exps);
+    free(d);
+}
+
+PolyDist *PolyDistAdd(const PolyDist *p, const PolyDist *q) {
+    size_t nvars = p->nvars > q->nvars ? p->nvars : q->nvars;
+    uint64_t max_exp = p->max_exp > q->max_exp ? p->max_exp : q->max_exp;
+
+    unsigned bits;
+    size_t words;
+    if (!ChooseLayout(nvars, max_exp, &bits, &words)) return NULL;
+
+    uint64_t *p_exps = ExpsInLayout(p, bits, words);
+    uint64_t *q_exps = ExpsInLayout(q, bits, words);
+    PolyDist *res = DistCreate(nvars, bits, words, max_exp,
+                               p->size + q->size);
+
+    size_t i = 0, j = 0;
+    while (i < p->size && j < q->size) {
+        const uint64_t *a = &p_exps[i * words];
+        const uint64_t *b = &q_exps[j * words];
+        int cmp = CompareExps(a, b, words);
+
+        if (cmp > 0) {
+            DistAppend(res, p->coeffs[i++], a);
+        } else if (cmp < 0) {
+            DistAppend(res, q->coeffs[j++], b);
+        } else {
+            DistAppend(res, p->coeffs[i++] + q->coeffs[j++], a);
+        }
+    }
+    for (; i < p->size; i++) {
+        DistAppend(res, p->coeffs[i], &p_exps[i * words]);
+    }
+    for (; j < q->size; j++) {
+        DistAppend(res, q->coeffs[j], &q_exps[j * words]);
+    }
+
+    if (p_exps != p->exps) free(p_exps);
+    if (q_exps != q->exps) free(q_exps);
+    return res;
+}
+
+/**
+ * Element kopca używanego przy mnożeniu wielomianów w postaci rozłożonej.
+ * Reprezentuje iloczyn wyrazu o indeksie @p i z krótszego czynnika i wyrazu
+ * o indeksie @p j z dłuższego czynnika.
+ */
+typedef struct DistHeapEntry {
+    uint64_t exps[DIST_MAX_WORDS]; ///< wektor wykładników iloczynu wyrazów
+    size_t i;                      ///< indeks wyrazu w krótszym czynniku
+    size_t j;                      ///< indeks wyrazu w dłuższym czynniku
+} DistHeapEntry;
+
+/**
+ * Przywraca własność kopca typu max (względem wektora wykładników) dla
+ * poddrzewa o korzeniu w elemencie o indeksie @p pos .
+ * @param[in] heap : tablica reprezentująca kopiec
+ * @param[in] size : liczba elementów kopca
+ * @param[in] pos : indeks przesuwanego w dół elementu
+ * @param[in] words : liczba słów wektora wykładników
+ */
+static void DistHeapSiftDown(DistHeapEntry *heap, size_t size, size_t pos,
+                             size_t words) {
+    DistHeapEntry entry = heap[pos];
+
+    while (2 * pos + 1 < size) {
+        size_t child = 2 * pos + 1;
+        if (child + 1 < size &&
+            CompareExps(heap[child + 1].exps, heap[child].exps, words) > 0) {
+            child++;
+        }
+        if (CompareExps(heap[child].exps, entry.exps, words) <= 0) {
+            break;
+        }
+        heap[pos] = heap[child];
+        pos = child;
+    }
+
+    heap[pos] = entry;
+}
+
+/**
+ * Wyznacza wektor wykładników iloczynu dwóch wyrazów.
+ * @param[out] dst : wektor wykładników iloczynu
+ * @param[in] a : wektor wykładników pierwszego wyrazu
+ * @param[in] b : wektor wykładników drugiego wyrazu
+ * @param[in] words : liczba słów wektorów
+ */
+static inline void AddExps(uint64_t *dst, const uint64_t *a,
+                           const uint64_t *b, size_t words) {
+    for (size_t w = 0; w < words; w++) {
+        dst[w] = a[w] + b[w];
+    }
+}
+
+PolyDist *PolyDistMul(const PolyDist *p, const PolyDist *q) {
+    size_t nvars = p->nvars > q->nvars ? p->nvars : q->nvars;
+    uint64_t max_exp = p->max_exp + q->max_exp;
+
+    unsigned bits;
+    size_t words;
+    if (!ChooseLayout(nvars, max_exp, &bits, &words)) return NULL;
+
+    PolyDist *res = DistCreate(nvars, bits, words, max_exp,
+                               p->size + q->size);
+    if (p->size == 0 || q->size == 0) return res;
+
+    // iloczyny wyrazów są generowane malejąco za pomocą kopca, tak jak
+    // w funkcji `PolyMul`
+    if (p->size > q->size) {
+        const PolyDist *tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    uint64_t *p_exps = ExpsInLayout(p, bits, words);
+    uint64_t *q_exps = ExpsInLayout(q, bits, words);
+
+    size_t heap_size = p->size;
+    DistHeapEntry *heap =
+        (DistHeapEntry*) calloc(heap_size, sizeof(DistHeapEntry));
+    CheckPtr(heap);
+
+    for (size_t i = 0; i < heap_size; i++) {
+        AddExps(heap[i].exps, &p_exps[i * words], &q_exps[0], words);
+        heap[i].i = i;
+        heap[i].j = 0;
+    }
+    // wyrazy są posortowane malejąco, więc tablica jest już kopcem
+
+    uint64_t acc_exps[DIST_MAX_WORDS];
+    memcpy(acc_exps, heap[0].exps, sizeof acc_exps);
+    uint64_t acc = 0;
+
+    while (heap_size > 0) {
+        DistHeapEntry *top = &heap[0];
+
+        if (CompareExps(top->exps, acc_exps, words) != 0) {
+            DistAppend(res, acc, acc_exps);
+            acc = 0;
+            memcpy(acc_exps, top->exps, sizeof acc_exps);
+        }
+
+        acc += p->coeffs[top->i] * q->coeffs[top->j];
+
+        if (top->j + 1 < q->size) {
+            top->j++;
+            AddExps(top->exps, &p_exps[top->i * words],
+                    &q_exps[top->j * words], words);
+        } else {
+            heap[0] = heap[--heap_size];
+        }
+        DistHeapSiftDown(heap, heap_size, 0, words);
+    }
+
+    DistAppend(res, acc, acc_exps);
+    free(heap);
+
+    if (p_exps != p->exps) free(p_exps);
+    if (q_exps != q->exps) free(q_exps);
+    return res;
+}
+
+/**
+ * Podnosi liczbę do potęgi modulo @f$2^{64}@f$.
+ * @param[in] x : podstawa
+ * @param[in] exp : wykładnik
+ * @return @f$x^{exp}@f$
+ */
+static uint64_t PowU64(uint64_t x, uint64_t exp) {
+    uint64_t res = 1;
+    while (exp > 0) {
+        if (exp & 1) res *= x;
+        x *= x;
+        exp >>= 1;
+    }
+    return res;
+}
+
+poly_coeff_t PolyDistEval(const PolyDist *d, size_t k,
+                          const poly_coeff_t x[]) {
+    if (d->size == 0) return 0;
+
+    // kolejne wyrazy często mają te same wykładniki pierwszych zmiennych,
+    // więc dla każdej zmiennej zapamiętywana jest ostatnio liczona potęga
+    uint64_t *last_exp = (uint64_t*) calloc(d->nvars + 1, sizeof(uint64_t));
+    uint64_t *last_pow = (uint64_t*) calloc(d->nvars + 1, sizeof(uint64_t));
+    CheckPtr(last_exp);
+    CheckPtr(last_pow);
+    for (size_t var = 0; var < d->nvars; var++) {
+        last_pow[var] = 1;
+    }
+
+    uint64_t res = 0;
+    for (size_t t = 0; t < d->size; t++) {
+        uint64_t term = d->coeffs[t];
+        for (size_t var = 0; var < d->nvars; var++) {
+            uint64_t e = GetField(&d->exps[t * d->words], var, d->bits);
+            if (e != last_exp[var]) {
+                uint64_t val = var < k ? (uint64_t) x[var] : 0;
+                last_exp[var] = e;
+                last_pow[var] = PowU64(val, e);
+            }
+            term *= last_pow[var];
+        }
+        res += term;
+    }
+
+    free(last_exp);
+    free(last_pow);
+    return (poly_coeff_t) res;
+}
@@ -0,0 +1,73 @@
+/** @file
+  Interfejs wielomianów w postaci rozłożonej - listy wyrazów ze spakowanymi
+  wektorami wykładników.
+
+  @authors Paweł Olejnik <po417770@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#ifndef POLY_DIST_H
+#define POLY_DIST_H
+
+#include "poly.h"
+
+/**
+ * Struktura reprezentująca wielomian w postaci rozłożonej: listę wyrazów
+ * postaci @f$c x_0^{e_0} \cdots x_{n-1}^{e_{n-1}}@f$ posortowaną malejąco
+ * leksykograficznie względem wektorów wykładników. Wykładniki wszystkich
+ * zmiennych wyrazu są spakowane w jedno lub dwa słowa 64-bitowe, więc
+ * porównanie słów porównuje wyrazy, a ich suma odpowiada iloczynowi wyrazów.
+ */
+typedef struct PolyDist PolyDist;
+
+/**
+ * Zamienia wielomian na postać rozłożoną. Nie modyfikuje wielomianu @p p .
+ * @param[in] p : wielomian
+ * @return wielomian w postaci rozłożonej lub `NULL`, jeśli wykładniki
+ * wszystkich zmiennych nie mieszczą się w dwóch słowach 64-bitowych
+ */
+PolyDist *PolyDistFromPoly(const Poly *p);
+
+/**
+ * Zamienia wielomian w postaci rozłożonej z powrotem na wielomian.
+ * @param[in] d : wielomian w postaci rozłożonej
+ * @return wielomian równy @p d
+ */
+Poly PolyDistToPoly(const PolyDist *d);
+
+/**
+ * Usuwa wielomian w postaci rozłożonej z pamięci.
+ * @param[in] d : wielomian w postaci rozłożonej
+ */
+void PolyDistDestroy(PolyDist *d);
+
+/**
+ * Dodaje dwa wielomiany w postaci rozłożonej.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$ lub `NULL`, jeśli wykładniki wyniku nie mieszczą się
+ * w dwóch słowach 64-bitowych
+ */
+PolyDist *PolyDistAdd(const PolyDist *p, const PolyDist *q);
+
+/**
+ * Mnoży dwa wielomiany w postaci rozłożonej.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$ lub `NULL`, jeśli wykładniki wyniku nie mieszczą się
+ * w dwóch słowach 64-bitowych
+ */
+PolyDist *PolyDistMul(const PolyDist *p, const PolyDist *q);
+
+/**
+ * Wylicza wartość wielomianu w postaci rozłożonej w punkcie, tak jak funkcja
+ * `PolyEval`. Pod zmienne o indeksach nie mniejszych niż @p k podstawiane
+ * są zera.
+ * @param[in] d : wielomian w postaci rozłożonej
+ * @param[in] k : liczba wartości w tablicy @p x
+ * @param[in] x : tablica wartości kolejnych zmiennych
+ * @return wartość wielomianu
+ */
+poly_coeff_t PolyDistEval(const PolyDist *d, size_t k, const poly_coeff_t x[]);
+
+#endif /* POLY_DIST_H */
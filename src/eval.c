@@ -0,0 +1,492 @@
+/** @file
+  Implementacja kompilacji wielomianów i wyliczania ich wartości w wielu
+  punktach naraz.
+
+  Wielomian jest spłaszczany do listy wyrazów postaci
+  @f$c x_0^{e_0} \cdots x_{k-1}^{e_{k-1}}@f$. Dla każdego bloku punktów
+  liczone są potęgi współrzędnych o wykładnikach występujących
+  w wielomianie, a następnie wartości wyrazów są sumowane jednocześnie dla
+  wszystkich punktów bloku. Obliczenia są wykonywane na liczbach bez znaku,
+  co daje te same wyniki modulo @f$2^{64}@f$ co funkcja `PolyEval`.
+
+  @authors Paweł Olejnik <po417770@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eval.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+/** Czy kompilowana jest wersja jąder obliczeniowych używająca AVX2. */
+#define EVAL_AVX2
+#endif
+
+/** Liczba punktów przetwarzanych jednocześnie. */
+#define EVAL_BLOCK 32
+
+/** Liczba wierszy tablicy potęg trzymanych na stosie dla jednego punktu. */
+#define EVAL_LOCAL_ROWS 256
+
+/**
+ * Sprawdza poprawną alokację pamięci.
+ * Jeśli pamięć nie została poprawnie zaalokowana, kończy program z kodem 1.
+ * @param p : wskaźnik na zaalokowaną pamięć
+ */
+static void CheckPtr(const void *p) {
+    if (p == NULL) exit(1);
+}
+
+/**
+ * Struktura przechowująca skompilowany wielomian - listę wyrazów i opis
+ * tablicy potęg współrzędnych punktu. Każdy wiersz tablicy potęg zawiera
+ * jedną potęgę jednej współrzędnej (dla wszystkich punktów bloku) i jest
+ * współdzielony przez wszystkie wyrazy, w których ta potęga występuje.
+ */
+struct PolyProgram {
+    size_t nvars;         ///< liczba zmiennych
+    size_t nterms;        ///< liczba wyrazów
+    uint64_t *coeffs;     ///< współczynniki wyrazów
+    size_t *var_start;    ///< pierwszy wiersz tablicy potęg zmiennej `i`
+                          ///< (`nvars + 1` elementów)
+    poly_exp_t *row_exp;  ///< wykładnik potęgi w danym wierszu tablicy potęg
+    poly_exp_t *row_gap;  ///< różnica wykładników danego i poprzedniego
+                          ///< wiersza tej samej zmiennej
+    size_t *term_start;   ///< początek listy czynników wyrazu `t`
+                          ///< (`nterms + 1` elementów)
+    size_t *factors;      ///< wiersze tablicy potęg mnożone przez
+                          ///< współczynnik kolejnych wyrazów
+};
+
+/**
+ * Pomocnicza struktura używana przy kompilacji wielomianu, przechowująca
+ * wykładnik zmiennej `i` w wyrazie `t` pod indeksem `i * nterms + t`.
+ */
+typedef struct TermExps {
+    size_t nvars;         ///< liczba zmiennych
+    size_t nterms;        ///< liczba wyrazów
+    uint64_t *coeffs;     ///< współczynniki wyrazów
+    poly_exp_t *exps;     ///< wykładniki zmiennych w wyrazach
+} TermExps;
+
+/**
+ * Zestaw jąder obliczeniowych działających na blokach `EVAL_BLOCK` liczb.
+ */
+typedef struct EvalKernels {
+    /** Mnoży bloki: `dst[b] = a[b] * b[b]`. */
+    void (*mul)(uint64_t *dst, const uint64_t *a, const uint64_t *b);
+    /** Dodaje wartość wyrazu: `acc[b] += c * table[f_0][b] * ...`. */
+    void (*term)(uint64_t *acc, uint64_t c, const uint64_t *table,
+                 const size_t *factors, size_t count);
+} EvalKernels;
+
+/**
+ * Mnoży bloki liczb.
+ * @param[out] dst : blok wynikowy
+ * @param[in] a : pierwszy blok czynników
+ * @param[in] b : drugi blok czynników
+ */
+static void ScalarMul(uint64_t *dst, const uint64_t *a, const uint64_t *b) {
+    for (size_t i = 0; i < EVAL_BLOCK; i++) {
+        dst[i] = a[i] * b[i];
+    }
+}
+
+/**
+ * Dodaje do bloku sum wartość wyrazu w punktach bloku.
+ * @param[in,out] acc : blok sum
+ * @param[in] c : współczynnik wyrazu
+ * @param[in] table : tablica potęg
+ * @param[in] factors : wiersze tablicy potęg będące czynnikami wyrazu
+ * @param[in] count : liczba czynników
+ */
+static void ScalarTerm(uint64_t *acc, uint64_t c, const uint64_t *table,
+                       const size_t *factors, size_t count) {
+    uint64_t prod[EVAL_BLOCK];
+    for (size_t i = 0; i < EVAL_BLOCK; i++) {
+        prod[i] = c;
+    }
+    for (size_t f = 0; f < count; f++) {
+        const uint64_t *row = table + factors[f] * EVAL_BLOCK;
+        for (size_t i = 0; i < EVAL_BLOCK; i++) {
+            prod[i] *= row[i];
+        }
+    }
+    for (size_t i = 0; i < EVAL_BLOCK; i++) {
+        acc[i] += prod[i];
+    }
+}
+
+/** Skalarne jądra obliczeniowe. */
+static const EvalKernels scalar_kernels = {
+    .mul = ScalarMul,
+    .term = ScalarTerm
+};
+
+#ifdef EVAL_AVX2
+
+/**
+ * Mnoży czwórki liczb 64-bitowych modulo @f$2^{64}@f$. AVX2 nie ma takiej
+ * instrukcji, więc iloczyn jest składany z mnożeń połówek 32-bitowych.
+ * @param[in] a : pierwsza czwórka czynników
+ * @param[in] b : druga czwórka czynników
+ * @return czwórka iloczynów
+ */
+__attribute__((target("avx2")))
+static inline __m256i Mul64(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i a_hi_b = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+    __m256i a_b_hi = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+    __m256i cross = _mm256_add_epi64(a_hi_b, a_b_hi);
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+/**
+ * Mnoży bloki liczb, używając instrukcji AVX2.
+ * @param[out] dst : blok wynikowy
+ * @param[in] a : pierwszy blok czynników
+ * @param[in] b : drugi blok czynników
+ */
+__attribute__((target("avx2")))
+static void Avx2Mul(uint64_t *dst, const uint64_t *a, const uint64_t *b) {
+    for (size_t i = 0; i < EVAL_BLOCK; i += 4) {
+        __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+        _mm256_storeu_si256((__m256i*) (dst + i), Mul64(va, vb));
+    }
+}
+
+/**
+ * Dodaje do bloku sum wartość wyrazu w punktach bloku, używając instrukcji
+ * AVX2.
+ * @param[in,out] acc : blok sum
+ * @param[in] c : współczynnik wyrazu
+ * @param[in] table : tablica potęg
+ * @param[in] factors : wiersze tablicy potęg będące czynnikami wyrazu
+ * @param[in] count : liczba czynników
+ */
+__attribute__((target("avx2")))
+static void Avx2Term(uint64_t *acc, uint64_t c, const uint64_t *table,
+                     const size_t *factors, size_t count) {
+    for (size_t i = 0; i < EVAL_BLOCK; i += 4) {
+        __m256i prod = _mm256_set1_epi64x((long long) c);
+        for (size_t f = 0; f < count; f++) {
+            const uint64_t *row = table + factors[f] * EVAL_BLOCK + i;
+            prod = Mul64(prod, _mm256_loadu_si256((const __m256i*) row));
+        }
+        __m256i sum = _mm256_loadu_si256((const __m256i*) (acc + i));
+        _mm256_storeu_si256((__m256i*) (acc + i), _mm256_add_epi64(sum, prod));
+    }
+}
+
+/** Jądra obliczeniowe używające instrukcji AVX2. */
+static const EvalKernels avx2_kernels = {
+    .mul = Avx2Mul,
+    .term = Avx2Term
+};
+
+#endif /* EVAL_AVX2 */
+
+/**
+ * Wybiera najszybsze jądra obliczeniowe obsługiwane przez procesor.
+ * @return wskaźnik na zestaw jąder
+ */
+static const EvalKernels *SelectKernels(void) {
+#ifdef EVAL_AVX2
+    if (__builtin_cpu_supports("avx2")) return &avx2_kernels;
+#endif
+    return &scalar_kernels;
+}
+
+/**
+ * Przechodzi rekurencyjnie po wielomianie i zapisuje jego wyrazy do
+ * spłaszczonej struktury. Jeśli tablica współczynników nie jest jeszcze
+ * zaalokowana, jedynie zlicza wyrazy. Pod zmienne o indeksach nie mniejszych
+ * niż `nvars` podstawiane są zera.
+ * @param[in] p : wielomian będący współczynnikiem przy zmiennej @p var
+ * @param[in] var : indeks zmiennej
+ * @param[in,out] path : wykładniki zmiennych o indeksach mniejszych niż @p var
+ * @param[in,out] f : spłaszczone wyrazy wielomianu
+ * @param[in,out] t : liczba dotychczas przetworzonych wyrazów
+ */
+static void FlattenTerms(const Poly *p, size_t var, poly_exp_t *path,
+                         TermExps *f, size_t *t) {
+    if (PolyIsCoeff(p)) {
+        if (PolyIsZero(p)) return;
+        if (f->coeffs != NULL) {
+            f->coeffs[*t] = (uint64_t) p->coeff;
+            for (size_t i = 0; i < f->nvars; i++) {
+                f->exps[i * f->nterms + *t] = i < var ? path[i] : 0;
+            }
+        }
+        (*t)++;
+        return;
+    }
+
+    if (var >= f->nvars) {
+        const Mono *last = &p->arr[p->size - 1];
+        if (MonoGetExp(last) == 0) {
+            FlattenTerms(&last->p, var + 1, path, f, t);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < p->size; i++) {
+        path[var] = MonoGetExp(&p->arr[i]);
+        FlattenTerms(&p->arr[i].p, var + 1, path, f, t);
+    }
+}
+
+/**
+ * Porównuje wykładniki, tak aby funkcja qsort sortowała je rosnąco.
+ * @param[in] a : wskaźnik na wykładnik @f$a@f$
+ * @param[in] b : wskaźnik na wykładnik @f$b@f$
+ * @return : -1 jeśli @f$a<b@f$, 0 jeśli @f$a=b@f$, 1 jeśli @f$a>b@f$
+ */
+static int CompareExps(const void *a, const void *b) {
+    poly_exp_t x = *(const poly_exp_t*) a;
+    poly_exp_t y = *(const poly_exp_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Wyszukuje binarnie wykładnik w posortowanej rosnąco tablicy.
+ * @param[in] arr : tablica wykładników
+ * @param[in] size : liczba wykładników
+ * @param[in] exp : szukany wykładnik, występujący w tablicy
+ * @return indeks wykładnika w tablicy
+ */
+static size_t FindExp(const poly_exp_t *arr, size_t size, poly_exp_t exp) {
+    size_t lo = 0, hi = size;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (arr[mid] <= exp) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+PolyProgram *PolyProgramCompile(const Poly *p, size_t nvars) {
+    TermExps f = {.nvars = nvars};
+    poly_exp_t *path = (poly_exp_t*) calloc(nvars + 1, sizeof(poly_exp_t));
+    CheckPtr(path);
+
+    size_t t = 0;
+    FlattenTerms(p, 0, path, &f, &t);
+    f.nterms = t;
+
+    f.coeffs = (uint64_t*) calloc(f.nterms + 1, sizeof(uint64_t));
+    f.exps = (poly_exp_t*) calloc(f.nterms * nvars + 1, sizeof(poly_exp_t));
+    CheckPtr(f.coeffs);
+    CheckPtr(f.exps);
+
+    t = 0;
+    FlattenTerms(p, 0, path, &f, &t);
+    free(path);
+
+    PolyProgram *prog = (PolyProgram*) malloc(sizeof(PolyProgram));
+    CheckPtr(prog);
+    prog->nvars = nvars;
+    prog->nterms = f.nterms;
+    prog->coeffs = f.coeffs;
+    prog->var_start = (size_t*) calloc(nvars + 1, sizeof(size_t));
+    prog->row_exp =
+        (poly_exp_t*) calloc(f.nterms * nvars + 1, sizeof(poly_exp_t));
+    prog->row_gap =
+        (poly_exp_t*) calloc(f.nterms * nvars + 1, sizeof(poly_exp_t));
+    prog->term_start = (size_t*) calloc(f.nterms + 1, sizeof(size_t));
+    CheckPtr(prog->var_start);
+    CheckPtr(prog->row_exp);
+    CheckPtr(prog->row_gap);
+    CheckPtr(prog->term_start);
+
+    // różne niezerowe wykładniki kolejnych zmiennych, posortowane rosnąco
+    size_t rows = 0;
+    for (size_t i = 0; i < nvars; i++) {
+        prog->var_start[i] = rows;
+        poly_exp_t *column = prog->row_exp + rows;
+        size_t count = 0;
+        for (size_t j = 0; j < f.nterms; j++) {
+            if (f.exps[i * f.nterms + j] != 0) {
+                column[count++] = f.exps[i * f.nterms + j];
+            }
+        }
+        qsort(column, count, sizeof(poly_exp_t), CompareExps);
+
+        size_t unique = 0;
+        for (size_t j = 0; j < count; j++) {
+            if (unique == 0 || column[unique - 1] != column[j]) {
+                prog->row_gap[rows + unique] =
+                    column[j] - (unique == 0 ? 0 : column[unique - 1]);
+                column[unique++] = column[j];
+            }
+        }
+        rows += unique;
+    }
+    prog->var_start[nvars] = rows;
+
+    // czynniki wyrazów - wiersze tablicy potęg o niezerowych wykładnikach
+    size_t nfactors = 0;
+    for (size_t j = 0; j < f.nterms * nvars; j++) {
+        if (f.exps[j] != 0) nfactors++;
+    }
+    prog->factors = (size_t*) calloc(nfactors + 1, sizeof(size_t));
+    CheckPtr(prog->factors);
+
+    nfactors = 0;
+    for (size_t j = 0; j < f.nterms; j++) {
+        prog->term_start[j] = nfactors;
+        for (size_t i = 0; i < nvars; i++) {
+            poly_exp_t exp = f.exps[i * f.nterms + j];
+            if (exp != 0) {
+                size_t start = prog->var_start[i];
+                size_t count = prog->var_start[i + 1] - start;
+                prog->factors[nfactors++] =
+                    start + FindExp(prog->row_exp + start, count, exp);
+            }
+        }
+    }
+    prog->term_start[f.nterms] = nfactors;
+
+    free(f.exps);
+    return prog;
+}
+
+void PolyProgramDestroy(PolyProgram *prog) {
+    free(prog->coeffs);
+    free(prog->var_start);
+    free(prog->row_exp);
+    free(prog->row_gap);
+    free(prog->term_start);
+    free(prog->factors);
+    free(prog);
+}
+
+/**
+ * Pomocnicza funkcja do obliczania potęgi liczby modulo @f$2^{64}@f$.
+ * @param[in] x : podstawa
+ * @param[in] exp : wykładnik
+ * @return @f$x^{exp}@f$
+ */
+static uint64_t PowU64(uint64_t x, poly_exp_t exp) {
+    uint64_t res = 1;
+    while (exp > 0) {
+        if (exp % 2 == 1) res *= x;
+        exp /= 2;
+        x *= x;
+    }
+    return res;
+}
+
+poly_coeff_t PolyProgramEval(const PolyProgram *prog, const poly_coeff_t x[]) {
+    size_t rows = prog->var_start[prog->nvars];
+    uint64_t local[EVAL_LOCAL_ROWS];
+    uint64_t *pows = local;
+    if (rows > EVAL_LOCAL_ROWS) {
+        pows = (uint64_t*) malloc(rows * sizeof(uint64_t));
+        CheckPtr(pows);
+    }
+
+    for (size_t i = 0; i < prog->nvars; i++) {
+        for (size_t r = prog->var_start[i]; r < prog->var_start[i + 1]; r++) {
+            uint64_t gap_pow = PowU64((uint64_t) x[i], prog->row_gap[r]);
+            pows[r] = r == prog->var_start[i] ? gap_pow : pows[r-1] * gap_pow;
+        }
+    }
+
+    uint64_t res = 0;
+    for (size_t t = 0; t < prog->nterms; t++) {
+        uint64_t term = prog->coeffs[t];
+        for (size_t f = prog->term_start[t]; f < prog->term_start[t+1]; f++) {
+            term *= pows[prog->factors[f]];
+        }
+        res += term;
+    }
+
+    if (pows != local) free(pows);
+    return (poly_coeff_t) res;
+}
+
+/**
+ * Podnosi blok liczb do potęgi metodą szybkiego potęgowania.
+ * @param[in] k : jądra obliczeniowe
+ * @param[out] dst : blok wynikowy
+ * @param[in] x : blok podstaw
+ * @param[in] exp : wykładnik
+ * @param[in] base : pomocniczy blok
+ */
+static void PowBlock(const EvalKernels *k, uint64_t *dst, const uint64_t *x,
+                     poly_exp_t exp, uint64_t *base) {
+    for (size_t i = 0; i < EVAL_BLOCK; i++) {
+        dst[i] = 1;
+    }
+    memcpy(base, x, EVAL_BLOCK * sizeof(uint64_t));
+
+    while (exp > 0) {
+        if (exp % 2 == 1) k->mul(dst, dst, base);
+        exp /= 2;
+        if (exp > 0) k->mul(base, base, base);
+    }
+}
+
+void PolyProgramEvalBatch(const PolyProgram *prog, size_t npoints,
+                          const poly_coeff_t *xs, poly_coeff_t *out) {
+    const EvalKernels *k = SelectKernels();
+    size_t nvars = prog->nvars;
+    size_t rows = prog->var_start[nvars];
+
+    uint64_t *table =
+        (uint64_t*) calloc(rows + 1, EVAL_BLOCK * sizeof(uint64_t));
+    CheckPtr(table);
+
+    uint64_t x[EVAL_BLOCK], gap_pow[EVAL_BLOCK], tmp[EVAL_BLOCK];
+    uint64_t acc[EVAL_BLOCK];
+
+    for (size_t start = 0; start < npoints; start += EVAL_BLOCK) {
+        size_t n = npoints - start < EVAL_BLOCK ? npoints - start : EVAL_BLOCK;
+
+        // potęgi kolejnych zmiennych, liczone od najmniejszego wykładnika
+        // przez mnożenie przez potęgę różnicy kolejnych wykładników
+        for (size_t i = 0; i < nvars; i++) {
+            if (prog->var_start[i] == prog->var_start[i + 1]) continue;
+
+            for (size_t b = 0; b < EVAL_BLOCK; b++) {
+                x[b] = b < n ? (uint64_t) xs[(start + b) * nvars + i] : 0;
+            }
+
+            size_t end = prog->var_start[i + 1];
+            for (size_t r = prog->var_start[i]; r < end; r++) {
+                uint64_t *row = table + r * EVAL_BLOCK;
+                PowBlock(k, gap_pow, x, prog->row_gap[r], tmp);
+                if (r == prog->var_start[i]) {
+                    memcpy(row, gap_pow, sizeof(gap_pow));
+                } else {
+                    k->mul(row, row - EVAL_BLOCK, gap_pow);
+                }
+            }
+        }
+
+        memset(acc, 0, sizeof(acc));
+        for (size_t t = 0; t < prog->nterms; t++) {
+            k->term(acc, prog->coeffs[t], table,
+                    prog->factors + prog->term_start[t],
+                    prog->term_start[t + 1] - prog->term_start[t]);
+        }
+
+        for (size_t b = 0; b < n; b++) {
+            out[start + b] = (poly_coeff_t) acc[b];
+        }
+    }
+
+    free(table);
+}
+
+void PolyEvalBatch(const Poly *p, size_t nvars, size_t npoints,
+                   const poly_coeff_t *xs, poly_coeff_t *out) {
+    PolyProgram *prog = PolyProgramCompile(p, nvars);
+    PolyProgramEvalBatch(prog, npoints, xs, out);
+    PolyProgramDestroy(prog);
+}
@@ -0,0 +1,79 @@
+/** @file
+  Interfejs kompilacji wielomianów i wyliczania ich wartości w wielu
+  punktach naraz.
+
+  @authors Paweł Olejnik <po417770@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#ifndef POLY_EVAL_H
+#define POLY_EVAL_H
+
+#include "poly.h"
+
+/**
+ * Struktura reprezentująca skompilowany wielomian: listę wyrazów z ich
+ * współczynnikami oraz listę potęg współrzędnych punktu, z których każda
+ * jest liczona raz i współdzielona przez wszystkie wyrazy, w których
+ * występuje.
+ */
+typedef struct PolyProgram PolyProgram;
+
+/**
+ * Kompiluje wielomian do postaci, której wartość można wielokrotnie
+ * wyliczać bez przechodzenia po strukturze wielomianu. Skompilowany
+ * wielomian nie zależy od wielomianu @p p , który można potem usunąć.
+ * Pod zmienne o indeksach nie mniejszych niż @p nvars podstawiane są zera,
+ * tak jak w funkcji `PolyEval`.
+ * @param[in] p : wielomian
+ * @param[in] nvars : liczba współrzędnych punktów
+ * @return skompilowany wielomian
+ */
+PolyProgram *PolyProgramCompile(const Poly *p, size_t nvars);
+
+/**
+ * Usuwa skompilowany wielomian z pamięci.
+ * @param[in] prog : skompilowany wielomian
+ */
+void PolyProgramDestroy(PolyProgram *prog);
+
+/**
+ * Wylicza wartość skompilowanego wielomianu w punkcie. Nie modyfikuje
+ * skompilowanego wielomianu, więc może być wywoływana współbieżnie.
+ * @param[in] prog : skompilowany wielomian
+ * @param[in] x : tablica `nvars` współrzędnych punktu
+ * @return wartość wielomianu w punkcie @p x
+ */
+poly_coeff_t PolyProgramEval(const PolyProgram *prog, const poly_coeff_t x[]);
+
+/**
+ * Wylicza wartości skompilowanego wielomianu w @p npoints punktach, blokami
+ * punktów naraz. Na procesorach obsługujących instrukcje AVX2 wykorzystywana
+ * jest ich wektorowa wersja.
+ * @param[in] prog : skompilowany wielomian
+ * @param[in] npoints : liczba punktów
+ * @param[in] xs : tablica @p npoints punktów, każdy złożony z `nvars`
+ * kolejnych wartości
+ * @param[out] out : tablica, do której zapisywane są wartości wielomianu
+ * w kolejnych punktach
+ */
+void PolyProgramEvalBatch(const PolyProgram *prog, size_t npoints,
+                          const poly_coeff_t *xs, poly_coeff_t *out);
+
+/**
+ * Wylicza wartości wielomianu w @p npoints punktach. Wielomian jest najpierw
+ * kompilowany, a następnie wartości są liczone funkcją `PolyProgramEvalBatch`.
+ * Pod zmienne o indeksach nie mniejszych niż @p nvars podstawiane są zera,
+ * tak jak w funkcji `PolyEval`.
+ * @param[in] p : wielomian
+ * @param[in] nvars : liczba współrzędnych każdego punktu
+ * @param[in] npoints : liczba punktów
+ * @param[in] xs : tablica @p npoints punktów, każdy złożony z @p nvars
+ * kolejnych wartości
+ * @param[out] out : tablica, do której zapisywane są wartości wielomianu
+ * w kolejnych punktach
+ */
+void PolyEvalBatch(const Poly *p, size_t nvars, size_t npoints,
+                   const poly_coeff_t *xs, poly_coeff_t *out);
+
+#endif /* POLY_EVAL_H */
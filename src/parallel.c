@@ -0,0 +1,352 @@
+/** @file
+  Implementacja wykonywania obliczeń na wielomianach na wielu wątkach.
+
+  Zadania są wykonywane przez stałą pulę wątków, tworzoną przy pierwszym
+  użyciu. Każdy wątek puli ma własną kolejkę zadań (kolejkę Chase'a-Leva):
+  wątek dodaje i zdejmuje zadania z jej dołu, a pozostałe wątki kradną
+  zadania z jej góry. Wątek czekający na zakończenie swoich zadań wykonuje
+  w tym czasie inne zadania, więc zadania mogą bez zakleszczeń zlecać
+  kolejne zadania. Z puli korzysta naraz co najwyżej jeden wątek spoza niej;
+  pozostałe wykonują swoje zadania sekwencyjnie.
+
+  @authors Paweł Olejnik <po417770@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+
+/** Pojemność kolejki zadań jednego wątku (potęga dwójki). */
+#define DEQUE_CAPACITY 1024
+
+/** Liczba nieudanych przeszukań kolejek, po których wątek puli zasypia. */
+#define IDLE_ROUNDS 64
+
+/** Liczba wątków, na których mogą być wykonywane obliczenia. */
+static atomic_size_t threads = 1;
+
+/** Czy wątek wykonuje właśnie zadanie funkcji `PolyParallelFor`? */
+static _Thread_local bool in_parallel = false;
+
+/** Indeks kolejki wątku w puli lub -1, jeśli wątek nie korzysta z puli. */
+static _Thread_local long worker_id = -1;
+
+/**
+ * Struktura opisująca zadanie: wywołanie `fn(arg, index)`.
+ */
+typedef struct Task {
+    void (*fn)(void *arg, size_t i); ///< funkcja wykonująca zadanie
+    void *arg;                       ///< argument funkcji `fn`
+    size_t index;                    ///< indeks zadania
+    atomic_size_t *pending;          ///< licznik niezakończonych zadań
+} Task;
+
+/**
+ * Kolejka zadań wątku (Chase, Lev: Dynamic Circular Work-Stealing Deque,
+ * w wersji ze słabym modelem pamięci Lê i in.). Elementy o indeksach
+ * z przedziału `[top, bottom)` są zadaniami do wykonania.
+ */
+typedef struct Deque {
+    _Atomic(int64_t) top;                  ///< indeks najstarszego zadania
+    _Atomic(int64_t) bottom;               ///< indeks za najnowszym zadaniem
+    _Atomic(Task*) buffer[DEQUE_CAPACITY]; ///< zadania
+} Deque;
+
+/**
+ * Struktura przechowująca pulę wątków.
+ */
+typedef struct Pool {
+    size_t size;            ///< liczba kolejek; kolejka 0 należy do wątku
+                            ///< spoza puli, który z niej korzysta
+    Deque *deques;          ///< kolejki zadań
+    pthread_t *workers;     ///< wątki puli (`size - 1`)
+    pthread_mutex_t lock;   ///< blokada do usypiania wątków
+    pthread_cond_t wake;    ///< zmienna warunkowa budząca wątki
+    atomic_size_t epoch;    ///< licznik dodań zadań, na które czekały wątki
+    atomic_size_t sleepers; ///< liczba wątków przygotowujących się do snu
+    atomic_bool stop;       ///< czy wątki puli mają się zakończyć?
+} Pool;
+
+/** Pula wątków lub `NULL`, jeśli nie została jeszcze utworzona. */
+static Pool *pool = NULL;
+
+/** Blokada wątku spoza puli, który z niej korzysta. */
+static pthread_mutex_t pool_owner = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Sprawdza poprawną alokację pamięci.
+ * Jeśli pamięć nie została poprawnie zaalokowana, kończy program z kodem 1.
+ * @param p : wskaźnik na zaalokowaną pamięć
+ */
+static void CheckPtr(const void *p) {
+    if (p == NULL) exit(1);
+}
+
+/**
+ * Dodaje zadanie na dół kolejki. Może być wywołana tylko przez właściciela
+ * kolejki.
+ * @param[in,out] d : kolejka
+ * @param[in] task : zadanie
+ * @return czy w kolejce było miejsce?
+ */
+static bool DequePush(Deque *d, Task *task) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= DEQUE_CAPACITY) return false;
+
+    atomic_store_explicit(&d->buffer[b % DEQUE_CAPACITY], task,
+                          memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Zdejmuje najnowsze zadanie z dołu kolejki. Może być wywołana tylko przez
+ * właściciela kolejki.
+ * @param[in,out] d : kolejka
+ * @return zadanie lub `NULL`, jeśli kolejka jest pusta
+ */
+static Task *DequeTake(Deque *d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    Task *task = atomic_load_explicit(&d->buffer[b % DEQUE_CAPACITY],
+                                      memory_order_relaxed);
+    if (t == b) {
+        // ostatnie zadanie - wyścig ze złodziejami
+        if (!atomic_compare_exchange_strong_explicit(
+                &d->top, &t, t + 1,
+                memory_order_seq_cst, memory_order_relaxed))
+        {
+            task = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+/**
+ * Kradnie najstarsze zadanie z góry kolejki innego wątku.
+ * @param[in,out] d : kolejka
+ * @return zadanie lub `NULL`, jeśli kolejka jest pusta lub inny wątek
+ * zabrał zadanie wcześniej
+ */
+static Task *DequeSteal(Deque *d) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+
+    Task *task = atomic_load_explicit(&d->buffer[t % DEQUE_CAPACITY],
+                                      memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(
+            &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        return NULL;
+    }
+    return task;
+}
+
+/**
+ * Szuka zadania: najpierw w kolejce wątku, potem w kolejkach pozostałych
+ * wątków puli.
+ * @param[in] id : indeks kolejki wątku
+ * @return zadanie lub `NULL`, jeśli nie znaleziono zadania
+ */
+static Task *FindTask(size_t id) {
+    Task *task = DequeTake(&pool->deques[id]);
+    for (size_t i = 1; task == NULL && i < pool->size; i++) {
+        task = DequeSteal(&pool->deques[(id + i) % pool->size]);
+    }
+    return task;
+}
+
+/**
+ * Wykonuje zadanie i zmniejsza licznik niezakończonych zadań. Po
+ * zmniejszeniu licznika zadanie może już nie istnieć.
+ * @param[in] task : zadanie
+ */
+static void RunTask(Task *task) {
+    atomic_size_t *pending = task->pending;
+    bool was_parallel = in_parallel;
+    in_parallel = true;
+    task->fn(task->arg, task->index);
+    in_parallel = was_parallel;
+    atomic_fetch_sub_explicit(pending, 1, memory_order_release);
+}
+
+/**
+ * Budzi uśpione wątki puli po dodaniu zadań.
+ */
+static void PoolNotify(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&pool->sleepers) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        atomic_fetch_add(&pool->epoch, 1);
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * Pętla wątku puli: wykonuje znalezione zadania, a jeśli przez dłuższy czas
+ * ich nie ma - zasypia do czasu dodania nowych zadań.
+ * @param[in] arg : indeks kolejki wątku
+ * @return `NULL`
+ */
+static void *PoolWorker(void *arg) {
+    worker_id = (long) (uintptr_t) arg;
+    size_t idle = 0;
+
+    while (!atomic_load(&pool->stop)) {
+        Task *task = FindTask((size_t) worker_id);
+        if (task != NULL) {
+            RunTask(task);
+            idle = 0;
+        } else if (++idle < IDLE_ROUNDS) {
+            sched_yield();
+        } else {
+            // zadanie dodane po zwiększeniu `sleepers` zmienia `epoch`
+            atomic_fetch_add(&pool->sleepers, 1);
+            size_t epoch = atomic_load(&pool->epoch);
+            task = FindTask((size_t) worker_id);
+            if (task == NULL) {
+                pthread_mutex_lock(&pool->lock);
+                while (atomic_load(&pool->epoch) == epoch &&
+                       !atomic_load(&pool->stop))
+                {
+                    pthread_cond_wait(&pool->wake, &pool->lock);
+                }
+                pthread_mutex_unlock(&pool->lock);
+            }
+            atomic_fetch_sub(&pool->sleepers, 1);
+            if (task != NULL) RunTask(task);
+            idle = 0;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Tworzy pulę wątków.
+ * @param[in] size : liczba wątków, wliczając wątek spoza puli
+ */
+static void PoolCreate(size_t size) {
+    pool = (Pool*) malloc(sizeof(Pool));
+    CheckPtr(pool);
+    pool->size = size;
+    pool->deques = (Deque*) calloc(size, sizeof(Deque));
+    pool->workers = (pthread_t*) malloc((size - 1) * sizeof(pthread_t));
+    CheckPtr(pool->deques);
+    CheckPtr(pool->workers);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->epoch, 0);
+    atomic_init(&pool->sleepers, 0);
+    atomic_init(&pool->stop, false);
+
+    // jeśli nie udało się utworzyć wątku, to zadania wykonają pozostałe
+    for (size_t i = 1; i < size; i++) {
+        if (pthread_create(&pool->workers[i-1], NULL, PoolWorker,
+                           (void*) (uintptr_t) i) != 0)
+        {
+            pool->size = i;
+            break;
+        }
+    }
+}
+
+/**
+ * Kończy wątki puli i usuwa ją z pamięci.
+ */
+static void PoolDestroy(void) {
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->stop, true);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 1; i < pool->size; i++) {
+        pthread_join(pool->workers[i-1], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+    pool = NULL;
+}
+
+void PolySetThreads(size_t count) {
+    pthread_mutex_lock(&pool_owner);
+    if (pool != NULL) PoolDestroy();
+    atomic_store(&threads, count == 0 ? 1 : count);
+    pthread_mutex_unlock(&pool_owner);
+}
+
+size_t PolyGetThreads(void) {
+    return atomic_load(&threads);
+}
+
+bool PolyInParallel(void) {
+    return in_parallel;
+}
+
+void PolyParallelFor(size_t n, void (*task)(void *arg, size_t i), void *arg) {
+    atomic_size_t pending;
+    atomic_init(&pending, n);
+
+    bool owner = false;
+    if (worker_id < 0 && n > 1 && PolyGetThreads() > 1 &&
+        pthread_mutex_trylock(&pool_owner) == 0)
+    {
+        owner = true;
+        if (pool == NULL) PoolCreate(PolyGetThreads());
+        worker_id = 0;
+    }
+
+    if (worker_id < 0) {
+        for (size_t i = 0; i < n; i++) {
+            Task t = {.fn = task, .arg = arg, .index = i, .pending = &pending};
+            RunTask(&t);
+        }
+        return;
+    }
+
+    Task *tasks = (Task*) malloc(n * sizeof(Task));
+    CheckPtr(tasks);
+    Deque *d = &pool->deques[worker_id];
+    // zadania są dodawane od końca, więc wątek wywołujący zaczyna od
+    // pierwszego, a złodzieje - od ostatniego
+    for (size_t i = n; i-- > 0;) {
+        tasks[i] = (Task) {.fn = task, .arg = arg, .index = i,
+                           .pending = &pending};
+        if (!DequePush(d, &tasks[i])) RunTask(&tasks[i]);
+    }
+    PoolNotify();
+
+    while (atomic_load_explicit(&pending, memory_order_acquire) > 0) {
+        Task *t = FindTask((size_t) worker_id);
+        if (t != NULL) RunTask(t);
+        else sched_yield();
+    }
+    free(tasks);
+
+    if (owner) {
+        worker_id = -1;
+        pthread_mutex_unlock(&pool_owner);
+    }
+}
@@ -0,0 +1,51 @@
+/** @file
+  Interfejs wykonywania obliczeń na wielomianach na wielu wątkach.
+
+  @authors Paweł Olejnik <po417770@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#ifndef POLY_PARALLEL_H
+#define POLY_PARALLEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Ustawia liczbę wątków, na których mogą być wykonywane obliczenia
+ * (domyślnie 1, czyli obliczenia sekwencyjne). Obliczenia są
+ * rozdzielane na wątki tylko przy domyślnym alokatorze, ponieważ inne
+ * alokatory nie muszą być bezpieczne przy użyciu z wielu wątków. Kończy
+ * wątki utworzone dla poprzedniej liczby wątków, więc nie może być wywołana
+ * z wnętrza zadania funkcji `PolyParallelFor`.
+ * @param[in] count : liczba wątków; 0 jest traktowane jak 1
+ */
+void PolySetThreads(size_t count);
+
+/**
+ * Zwraca ustawioną liczbę wątków.
+ * @return liczba wątków
+ */
+size_t PolyGetThreads(void);
+
+/**
+ * Sprawdza, czy wywołujący wątek wykonuje właśnie zadanie funkcji
+ * `PolyParallelFor`. Mnożenie i składanie wielomianów wywołane w zadaniu
+ * nie jest dzielone na kolejne zadania.
+ * @return czy wątek wykonuje zadanie równoległe?
+ */
+bool PolyInParallel(void);
+
+/**
+ * Wykonuje zadania `task(arg, 0)`, ..., `task(arg, n - 1)` na co najwyżej
+ * `PolyGetThreads()` wątkach, wliczając wątek wywołujący, i czeka na
+ * zakończenie wszystkich zadań. Zadania trafiają do kolejki wątku
+ * wywołującego, z której zabierają je bezczynne wątki. Może być wywołana
+ * z wnętrza zadania; czekając, wątek wykonuje inne zadania.
+ * @param[in] n : liczba zadań
+ * @param[in] task : funkcja wykonująca zadanie o danym indeksie
+ * @param[in] arg : argument przekazywany do funkcji @p task
+ */
+void PolyParallelFor(size_t n, void (*task)(void *arg, size_t i), void *arg);
+
+#endif /* POLY_PARALLEL_H */
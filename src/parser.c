@@ -6,12 +6,28 @@
 */
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <limits.h>
 
 #include "parser.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+/** Czy kompilowana jest wersja wyszukiwania końca cyfr używająca AVX2. */
+#define PARSER_AVX2
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/**
+ * Czy cyfry są przetwarzane po osiem naraz jako słowo 64-bitowe (SWAR);
+ * wymaga kolejności bajtów little-endian.
+ */
+#define PARSER_SWAR
+#endif
+
 /**
  * Sprawdza poprawną alokację pamięci.
  * Jeśli pamięć nie została poprawnie zaalokowana, kończy program z kodem 1.
@@ -45,32 +61,21 @@ bool ParsePolyExp(char *s, char **endptr, poly_exp_t *val) {
 }
 
 bool ParseMonoSum(char *s, char **endptr, Poly *p) {
-    size_t monos_size = 0;
-    size_t monos_count = -1;
-    Mono *monos = (Mono*) calloc(monos_size, sizeof(Mono));
-    CheckPtr(monos);
+    PolyBuilder *builder = PolyBuilderBegin();
 
     do {
         Mono new_mono;
         if (!ParseMono(s, endptr, &new_mono)) {
-            DestroyMonoArray(monos, monos_count+1);
+            PolyBuilderDestroy(builder);
             return false;
         }
         s = *endptr + 1;
 
-        if (++monos_count == monos_size) {
-            monos_size = 1 + 2 * monos_size;
-            Mono *tmp_monos = (Mono*) realloc(monos, monos_size * sizeof(Mono));
-            CheckPtr(tmp_monos);
-            monos = tmp_monos;
-        }
-
-        monos[monos_count] = new_mono;
+        PolyBuilderAddMono(builder, &new_mono);
 
     } while (**endptr == '+');
 
-    *p = PolyAddMonos(++monos_count, monos);
-    free(monos);
+    *p = PolyBuilderFinish(builder);
     return true;
 }
 
@@ -112,3 +117,390 @@ bool ParseMono(char *s, char **endptr, Mono *m) {
     (*endptr)++;
     return true;
 }
+
+/** Klasy znaków rozróżniane przez parser linii. */
+enum CharClass {
+    CLASS_OTHER,  ///< znak niedozwolony w wielomianie
+    CLASS_DIGIT,  ///< cyfra
+    CLASS_MINUS,  ///< `-`
+    CLASS_PLUS,   ///< `+`
+    CLASS_COMMA,  ///< `,`
+    CLASS_OPEN,   ///< `(`
+    CLASS_CLOSE,  ///< `)`
+    CLASS_END,    ///< koniec linii
+    CLASS_COUNT   ///< liczba klas
+};
+
+/** Klasy kolejnych wartości typu `unsigned char`. */
+static const unsigned char char_classes[UCHAR_MAX + 1] = {
+    ['0'] = CLASS_DIGIT, ['1'] = CLASS_DIGIT, ['2'] = CLASS_DIGIT,
+    ['3'] = CLASS_DIGIT, ['4'] = CLASS_DIGIT, ['5'] = CLASS_DIGIT,
+    ['6'] = CLASS_DIGIT, ['7'] = CLASS_DIGIT, ['8'] = CLASS_DIGIT,
+    ['9'] = CLASS_DIGIT,
+    ['-'] = CLASS_MINUS, ['+'] = CLASS_PLUS, [','] = CLASS_COMMA,
+    ['('] = CLASS_OPEN, [')'] = CLASS_CLOSE
+};
+
+/** Stany parsera linii, nazwane od tego, czego parser oczekuje. */
+enum ParserState {
+    STATE_POLY,   ///< początku wielomianu
+    STATE_MONO,   ///< początku kolejnego jednomianu sumy
+    STATE_COMMA,  ///< przecinka po współczynniku jednomianu
+    STATE_EXP,    ///< wykładnika jednomianu
+    STATE_CLOSE,  ///< nawiasu zamykającego jednomian
+    STATE_SUM,    ///< `+` lub końca sumy jednomianów
+    STATE_END,    ///< końca linii
+    STATE_COUNT   ///< liczba stanów
+};
+
+/** Akcje parsera linii. */
+enum ParserAction {
+    ACTION_ERROR,     ///< wielomian jest niepoprawny
+    ACTION_SKIP,      ///< pominięcie znaku
+    ACTION_OPEN_SUM,  ///< początek sumy jednomianów i jej pierwszego jednomianu
+    ACTION_OPEN_MONO, ///< początek kolejnego jednomianu sumy
+    ACTION_COEFF,     ///< wczytanie współczynnika
+    ACTION_EXP,       ///< wczytanie wykładnika
+    ACTION_MONO,      ///< koniec jednomianu
+    ACTION_SUM,       ///< koniec sumy jednomianów; znak nie jest pomijany
+    ACTION_ACCEPT     ///< koniec poprawnego wielomianu
+};
+
+/** Przejście parsera linii. */
+typedef struct Transition {
+    unsigned char action; ///< akcja
+    unsigned char next;   ///< następny stan, jeśli nie wyznacza go akcja
+} Transition;
+
+/**
+ * Tablica przejść parsera linii. Brak przejścia oznacza błąd. Po wczytaniu
+ * współczynnika lub końcu sumy następny stan zależy od tego, czy wielomian
+ * jest współczynnikiem jednomianu, czy całą linią.
+ */
+static const Transition transitions[STATE_COUNT][CLASS_COUNT] = {
+    [STATE_POLY] = {
+        [CLASS_OPEN] = {ACTION_OPEN_SUM, STATE_POLY},
+        [CLASS_DIGIT] = {ACTION_COEFF, 0},
+        [CLASS_MINUS] = {ACTION_COEFF, 0}
+    },
+    [STATE_MONO] = {[CLASS_OPEN] = {ACTION_OPEN_MONO, STATE_POLY}},
+    [STATE_COMMA] = {[CLASS_COMMA] = {ACTION_SKIP, STATE_EXP}},
+    [STATE_EXP] = {[CLASS_DIGIT] = {ACTION_EXP, STATE_CLOSE}},
+    [STATE_CLOSE] = {[CLASS_CLOSE] = {ACTION_MONO, STATE_SUM}},
+    [STATE_SUM] = {
+        [CLASS_OTHER] = {ACTION_SUM, 0},
+        [CLASS_DIGIT] = {ACTION_SUM, 0},
+        [CLASS_MINUS] = {ACTION_SUM, 0},
+        [CLASS_PLUS] = {ACTION_SKIP, STATE_MONO},
+        [CLASS_COMMA] = {ACTION_SUM, 0},
+        [CLASS_OPEN] = {ACTION_SUM, 0},
+        [CLASS_CLOSE] = {ACTION_SUM, 0},
+        [CLASS_END] = {ACTION_SUM, 0}
+    },
+    [STATE_END] = {[CLASS_END] = {ACTION_ACCEPT, 0}}
+};
+
+/** Funkcja zwracająca długość ciągu cyfr na początku tablicy znaków. */
+typedef size_t (*DigitRunFn)(const char *s, size_t len);
+
+/** Słowo 64-bitowe z bajtem @p b na każdej pozycji. */
+#define BYTES(b) (0x0101010101010101ULL * (b))
+
+#ifdef PARSER_SWAR
+
+/**
+ * Wczytuje osiem znaków jako słowo 64-bitowe; pierwszy znak jest najmłodszym
+ * bajtem.
+ * @param[in] s : tablica co najmniej ośmiu znaków
+ * @return słowo
+ */
+static inline uint64_t LoadWord(const char *s) {
+    uint64_t word;
+    memcpy(&word, s, sizeof(word));
+    return word;
+}
+
+/**
+ * Zlicza cyfry na początku słowa.
+ * @param[in] word : osiem znaków
+ * @return liczba początkowych bajtów słowa będących cyframi (od 0 do 8)
+ */
+static inline size_t WordDigitRun(uint64_t word) {
+    // cyfra ma starszą połówkę 3, a młodszą co najwyżej 9; dodanie 6 do
+    // młodszych połówek nie przenosi bitów między bajtami
+    uint64_t high = (word & BYTES(0xF0)) ^ BYTES(0x30);
+    uint64_t low = ((word & BYTES(0x0F)) + BYTES(0x06)) & BYTES(0xF0);
+    uint64_t non_digits =
+        (((high | low) >> 4) + BYTES(0x0F)) & BYTES(0x10);
+    if (non_digits == 0) return 8;
+    return (size_t) __builtin_ctzll(non_digits) / 8;
+}
+
+/**
+ * Oblicza wartość ośmiu cyfr dziesiętnych zapisanych w słowie, mnożąc
+ * i dodając sąsiednie grupy cyfr w kolejnych krokach.
+ * @param[in] word : osiem cyfr
+ * @return wartość liczby
+ */
+static inline unsigned long WordDigitsValue(uint64_t word) {
+    word &= BYTES(0x0F);
+    word = (word * 10 + (word >> 8)) & 0x00FF00FF00FF00FFULL;
+    word = (word * 100 + (word >> 16)) & 0x0000FFFF0000FFFFULL;
+    word = (word * 10000 + (word >> 32)) & 0xFFFFFFFFULL;
+    return (unsigned long) word;
+}
+
+#endif /* PARSER_SWAR */
+
+/**
+ * Zwraca długość ciągu cyfr na początku tablicy znaków, sprawdzając po osiem
+ * znaków naraz, jeśli to możliwe.
+ * @param[in] s : tablica znaków
+ * @param[in] len : liczba znaków w tablicy @p s
+ * @return liczba początkowych cyfr
+ */
+static size_t ScalarDigitRun(const char *s, size_t len) {
+    size_t i = 0;
+#ifdef PARSER_SWAR
+    while (len - i >= 8) {
+        size_t run = WordDigitRun(LoadWord(s + i));
+        i += run;
+        if (run < 8) return i;
+    }
+#endif
+    while (i < len && char_classes[(unsigned char) s[i]] == CLASS_DIGIT) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef PARSER_AVX2
+
+/**
+ * Zwraca długość ciągu cyfr na początku tablicy znaków, sprawdzając po 32
+ * znaki naraz instrukcjami AVX2.
+ * @param[in] s : tablica znaków
+ * @param[in] len : liczba znaków w tablicy @p s
+ * @return liczba początkowych cyfr
+ */
+__attribute__((target("avx2")))
+static size_t Avx2DigitRun(const char *s, size_t len) {
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+    size_t i = 0;
+    while (len - i >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (s + i));
+        __m256i d = _mm256_sub_epi8(v, zero);
+        __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, nine), d);
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(is_digit);
+        if (mask != UINT32_MAX) {
+            return i + (size_t) __builtin_ctz(~mask);
+        }
+        i += 32;
+    }
+    return i + ScalarDigitRun(s + i, len - i);
+}
+
+#endif /* PARSER_AVX2 */
+
+/**
+ * Wybiera najszybszą funkcję wyszukiwania końca cyfr obsługiwaną przez
+ * procesor.
+ * @return funkcja zwracająca długość ciągu cyfr
+ */
+static DigitRunFn SelectDigitRun(void) {
+#ifdef PARSER_AVX2
+    if (__builtin_cpu_supports("avx2")) return Avx2DigitRun;
+#endif
+    return ScalarDigitRun;
+}
+
+/**
+ * Oblicza wartość ciągu co najwyżej ośmiu cyfr.
+ * @param[in] s : tablica znaków zaczynająca się od cyfr
+ * @param[in] len : liczba znaków w tablicy @p s
+ * @param[in] count : liczba cyfr (od 1 do 8)
+ * @return wartość liczby
+ */
+static unsigned long DigitsValue(const char *s, size_t len, size_t count) {
+#ifdef PARSER_SWAR
+    if (len >= 8) {
+        // cyfry przesunięte na najstarsze bajty, poprzedzone zerami
+        return WordDigitsValue(LoadWord(s) << (8 * (8 - count)));
+    }
+#endif
+    unsigned long res = 0;
+    for (size_t i = 0; i < count; i++) {
+        res = 10 * res + (unsigned long) (s[i] - '0');
+    }
+    return res;
+}
+
+/**
+ * Wczytuje liczbę całkowitą bez znaku z kontrolą przekroczenia zakresu.
+ * Cyfry są przetwarzane grupami po osiem.
+ * @param[in] s : tablica znaków
+ * @param[in] len : liczba znaków w tablicy @p s
+ * @param[in,out] pos : pozycja pierwszej cyfry, zastępowana pozycją
+ * pierwszego znaku po liczbie
+ * @param[in] limit : największa dopuszczalna wartość, nie mniejsza niż
+ * @f$10^8@f$
+ * @param[in] digit_run : funkcja zwracająca długość ciągu cyfr
+ * @param[out] val : wczytana wartość
+ * @return czy liczba mieści się w zakresie?
+ */
+static bool ScanUnsigned(const char *s, size_t len, size_t *pos,
+                         unsigned long limit, DigitRunFn digit_run,
+                         unsigned long *val) {
+    static const unsigned long powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+    };
+
+    size_t i = *pos;
+    size_t end = i + digit_run(s + i, len - i);
+    unsigned long res = 0;
+    while (i < end) {
+        // pierwsza grupa jest niepełna, jeśli liczba cyfr nie dzieli się
+        // przez 8
+        size_t count = (end - i) % 8 == 0 ? 8 : (end - i) % 8;
+        unsigned long group = DigitsValue(s + i, len - i, count);
+        if (res > (limit - group) / powers[count]) return false;
+        res = res * powers[count] + group;
+        i += count;
+    }
+    *pos = i;
+    *val = res;
+    return true;
+}
+
+/**
+ * Wczytuje współczynnik, zapisany opcjonalnym znakiem `-` i cyframi.
+ * @param[in] s : tablica znaków
+ * @param[in] len : liczba znaków w tablicy @p s
+ * @param[in,out] pos : pozycja początku współczynnika, zastępowana pozycją
+ * pierwszego znaku po nim
+ * @param[in] digit_run : funkcja zwracająca długość ciągu cyfr
+ * @param[out] coeff : wczytany współczynnik
+ * @return czy współczynnik jest poprawny?
+ */
+static bool ScanCoeff(const char *s, size_t len, size_t *pos,
+                      DigitRunFn digit_run, poly_coeff_t *coeff) {
+    bool negative = s[*pos] == '-';
+    if (negative) (*pos)++;
+    if (*pos == len || char_classes[(unsigned char) s[*pos]] != CLASS_DIGIT) {
+        return false;
+    }
+
+    unsigned long limit = negative ?
+        (unsigned long) LONG_MAX + 1 : (unsigned long) LONG_MAX;
+    unsigned long val;
+    if (!ScanUnsigned(s, len, pos, limit, digit_run, &val)) return false;
+
+    *coeff = negative ? (poly_coeff_t) (0 - val) : (poly_coeff_t) val;
+    return true;
+}
+
+/** Suma jednomianów wczytywana przez parser linii. */
+typedef struct ParserFrame {
+    PolyBuilder *builder; ///< budowniczy sumy
+    Poly coeff;           ///< wczytany współczynnik bieżącego jednomianu
+} ParserFrame;
+
+bool ParsePolyLine(const char *s, size_t len, Poly *p) {
+    ParserFrame *frames = NULL;
+    size_t depth = 0, frames_size = 0;
+    Poly value = PolyZero();
+    poly_exp_t exp = 0;
+    int state = STATE_POLY;
+    size_t i = 0;
+    bool running = true, ok = false;
+    DigitRunFn digit_run = SelectDigitRun();
+
+    while (running) {
+        int cls = i < len ? char_classes[(unsigned char) s[i]] : CLASS_END;
+        Transition t = transitions[state][cls];
+        bool poly_done = false;
+
+        switch (t.action) {
+            case ACTION_SKIP:
+            case ACTION_OPEN_MONO:
+                i++;
+                break;
+            case ACTION_OPEN_SUM:
+                if (depth == frames_size) {
+                    frames_size = 2 * frames_size + 8;
+                    frames = realloc(frames, frames_size * sizeof(ParserFrame));
+                    CheckPtr(frames);
+                }
+                frames[depth].builder = PolyBuilderBegin();
+                frames[depth].coeff = PolyZero();
+                depth++;
+                i++;
+                break;
+            case ACTION_COEFF: {
+                poly_coeff_t coeff;
+                if (!ScanCoeff(s, len, &i, digit_run, &coeff)) {
+                    running = false;
+                    break;
+                }
+                value = PolyFromCoeff(coeff);
+                poly_done = true;
+                break;
+            }
+            case ACTION_EXP: {
+                unsigned long val;
+                if (!ScanUnsigned(s, len, &i, INT_MAX, digit_run, &val)) {
+                    running = false;
+                    break;
+                }
+                exp = (poly_exp_t) val;
+                break;
+            }
+            case ACTION_MONO: {
+                ParserFrame *top = &frames[depth - 1];
+                if (PolyIsZero(&top->coeff)) exp = 0;
+                Mono m = MonoFromPoly(&top->coeff, exp);
+                top->coeff = PolyZero();
+                PolyBuilderAddMono(top->builder, &m);
+                i++;
+                break;
+            }
+            case ACTION_SUM:
+                depth--;
+                value = PolyBuilderFinish(frames[depth].builder);
+                poly_done = true;
+                break;
+            case ACTION_ACCEPT:
+                ok = true;
+                running = false;
+                break;
+            default:
+                running = false;
+                break;
+        }
+
+        if (!running) {
+            break;
+        } else if (!poly_done) {
+            state = t.next;
+        } else if (depth == 0) {
+            state = STATE_END;
+        } else {
+            frames[depth - 1].coeff = value;
+            value = PolyZero();
+            state = STATE_COMMA;
+        }
+    }
+
+    if (ok) {
+        *p = value;
+    } else {
+        PolyDestroy(&value);
+        for (size_t j = 0; j < depth; j++) {
+            PolyDestroy(&frames[j].coeff);
+            PolyBuilderDestroy(frames[j].builder);
+        }
+    }
+    free(frames);
+    return ok;
+}
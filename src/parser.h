@@ -70,4 +70,21 @@ bool ParseMonoSum(char *s, char **endptr, Poly *p);
  */
 bool ParsePoly(char *s, char **endptr, Poly *p);
 
+/**
+ * Wczytuje wielomian zajmujący całą tablicę znaków. W przeciwieństwie do
+ * funkcji `ParsePoly` sprawdza znaki i buduje wielomian w jednym przejściu,
+ * bez rekurencji: automat sterowany tablicą przejść przechowuje otwarte sumy
+ * jednomianów na jawnym stosie, a liczby są wczytywane bez biblioteki
+ * standardowej, z kontrolą przekroczenia zakresu. Akceptuje te same
+ * wielomiany co funkcja `ParsePoly` wywołana dla całej linii, z wyjątkiem
+ * wykładników większych niż `INT_MAX`, które zawsze są błędne.
+ * @param[in] s : tablica znaków, z której czytany jest wielomian
+ * @param[in] len : liczba znaków w tablicy @p s ; znak `\0` wewnątrz
+ * tablicy jest niepoprawny
+ * @param[in] p : adres struktury `Poly`, której po poprawnym wczytaniu zostaje
+ * przypisany wczytany wielomian
+ * @return czy wielomian został wczytany poprawnie?
+ */
+bool ParsePolyLine(const char *s, size_t len, Poly *p);
+
 #endif /* POLY_PARSER_H */
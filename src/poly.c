@@ -6,10 +6,14 @@
 */
 
 #include <assert.h>
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "parallel.h"
 #include "poly.h"
 
 /**
@@ -21,31 +25,375 @@ static void CheckPtr(const void *p) {
     if (p == NULL) exit(1);
 }
 
+/** Czy kopie wielomianów mogą współdzielić tablice jednomianów? */
+static bool sharing = true;
+
+void PolySetSharing(bool enabled) {
+    sharing = enabled;
+}
+
 /**
- * Porównuje wykładniki jednomianów.
- * Wartości wykładników są porównywane w taki sposób, aby funkcja qsort
- * sortowała je w porządku malejącym.
- *
- * @param[in] a : jednomian @f$a@f$
- * @param[in] b : jednomian @f$b@f$
- *
- * @return : 1 jeśli @f$a<b@f$, 0 jeśli @f$a=b@f$, -1 jeśli @f$a>b@f$
- */ 
-static int CompareMonosExp(const void *a, const void *b) {
-    if (((Mono*)a)->exp <  ((Mono*)b)->exp) return 1;
-    if (((Mono*)a)->exp == ((Mono*)b)->exp) return 0;
-    return -1;
+ * Nagłówek umieszczany w pamięci bezpośrednio przed każdą tablicą jednomianów
+ * wielomianu. Tablica może być współdzielona przez kilka wielomianów i jest
+ * usuwana, gdy przestaje z niej korzystać ostatni z nich.
+ */
+typedef struct MonoArrayHeader {
+    atomic_size_t refs;     ///< liczba wielomianów korzystających z tablicy
+    _Atomic(uint64_t) hash; ///< skrót wielomianu lub 0, jeśli nie obliczony
+    size_t nvars;           ///< liczba zmiennych wielomianu
+    poly_exp_t deg;         ///< stopień wielomianu
+} MonoArrayHeader;
+
+_Static_assert(sizeof(MonoArrayHeader) % _Alignof(Mono) == 0,
+               "tablica jednomianów za nagłówkiem musi być wyrównana");
+
+/**
+ * Daje nagłówek tablicy jednomianów wielomianu.
+ * @param[in] arr : tablica jednomianów
+ * @return nagłówek tablicy
+ */
+static inline MonoArrayHeader *MonoArrayGetHeader(const Mono *arr) {
+    return (MonoArrayHeader*) arr - 1;
 }
 
 /**
- * Sortuje tabilcę jendomianow malejąco ze względu na wykladniki,
- * używajac funkcji qsort.
- * 
+ * Największa liczba zmiennych wielomianu, dla której zapamiętywane są jego
+ * stopnie ze względu na poszczególne zmienne. Dla głębszych wielomianów
+ * pamięć na stopnie rosłaby kwadratowo względem głębokości.
+ */
+#define MAX_CACHED_VAR_DEGS 32
+
+/**
+ * Daje stopnie wielomianu ze względu na zmienne o indeksach od 1 do
+ * `nvars - 1`, zapisane w pamięci za jego jednomianami, jeśli wielomian ma
+ * od 2 do `MAX_CACHED_VAR_DEGS` zmiennych. Stopień ze względu na zmienną 0
+ * jest wykładnikiem pierwszego jednomianu.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów
+ * @return tablica stopni; element o indeksie @f$i@f$ odpowiada zmiennej
+ * @f$i@f$
+ */
+static inline poly_exp_t *MonoArrayVarDegs(const Mono *arr, size_t size) {
+    return (poly_exp_t*) (arr + size);
+}
+
+/**
+ * Alokuje tablicę jednomianów. Tablica jest poprzedzona nagłówkiem
+ * z licznikiem odwołań równym 1.
+ * @param[in] count : liczba jednomianów
+ * @return zaalokowana tablica
+ */
+static Mono *MonoArrayAlloc(size_t count) {
+    MonoArrayHeader *header = (MonoArrayHeader*)
+        malloc(sizeof(MonoArrayHeader) + count * sizeof(Mono));
+    CheckPtr(header);
+    atomic_init(&header->refs, 1);
+    atomic_init(&header->hash, 0);
+    return (Mono*) (header + 1);
+}
+
+/**
+ * Zmienia rozmiar tablicy jednomianów.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] new_count : nowy rozmiar tablicy
+ * @return tablica o zmienionym rozmiarze
+ */
+static Mono *MonoArrayRealloc(Mono *arr, size_t new_count) {
+    MonoArrayHeader *header = (MonoArrayHeader*) realloc(
+            MonoArrayGetHeader(arr),
+            sizeof(MonoArrayHeader) + new_count * sizeof(Mono));
+    CheckPtr(header);
+    return (Mono*) (header + 1);
+}
+
+/**
+ * Zwalnia tablicę jednomianów.
+ * Nie usuwa jednomianów znajdujących się w tablicy.
+ * @param[in] arr : tablica jednomianów
+ */
+static void MonoArrayFree(Mono *arr) {
+    free(MonoArrayGetHeader(arr));
+}
+
+/**
+ * Usuwa odwołanie wielomianu do tablicy jednomianów. Jeśli było to ostatnie
+ * odwołanie, usuwa z pamięci jednomiany i zwalnia tablicę.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów
+ */
+static void MonoArrayRelease(Mono *arr, size_t size) {
+    MonoArrayHeader *header = MonoArrayGetHeader(arr);
+    if (atomic_fetch_sub_explicit(&header->refs, 1,
+                                  memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        MonoDestroy(&arr[i]);
+    }
+    MonoArrayFree(arr);
+}
+
+/**
+ * Najmniejsza liczba jednomianów, od której tablica o krótkich seriach
+ * jest sortowana pozycyjnie zamiast przez wstawianie.
+ */
+#define RADIX_SORT_MIN_SIZE 64
+
+/**
+ * Najmniejsza średnia długość serii, przy której tablica jest sortowana
+ * przez scalanie serii zamiast pozycyjnie.
+ */
+#define MIN_MERGED_RUN 8
+
+/**
+ * Wyznacza długość serii jednomianów zaczynającej się na początku tablicy:
+ * ciągu o nierosnących wykładnikach lub ciągu o ściśle rosnących
+ * wykładnikach.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów, dodatnia
+ * @param[out] ascending : czy seria ma ściśle rosnące wykładniki?
+ * @return długość serii
+ */
+static size_t MonoRunLength(const Mono *arr, size_t size, bool *ascending) {
+    size_t len = 1;
+    *ascending = size > 1 && MonoGetExp(&arr[0]) < MonoGetExp(&arr[1]);
+    if (*ascending) {
+        while (len < size &&
+               MonoGetExp(&arr[len-1]) < MonoGetExp(&arr[len])) {
+            len++;
+        }
+    } else {
+        while (len < size &&
+               MonoGetExp(&arr[len-1]) >= MonoGetExp(&arr[len])) {
+            len++;
+        }
+    }
+    return len;
+}
+
+/**
+ * Odwraca kolejność jednomianów w tablicy.
+ * @param[in,out] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów
+ */
+static void ReverseMonoArray(Mono *arr, size_t size) {
+    for (size_t i = 0, j = size; i + 1 < j; i++, j--) {
+        Mono tmp = arr[i];
+        arr[i] = arr[j-1];
+        arr[j-1] = tmp;
+    }
+}
+
+/**
+ * Wyznacza wyszukiwaniem wykładniczym, ile początkowych jednomianów tablicy
+ * posortowanej malejąco ma wykładnik większy niż @p exp (lub równy mu, jeśli
+ * @p or_equal ). Koszt jest logarytmiczny względem wyniku.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów
+ * @param[in] exp : wykładnik
+ * @param[in] or_equal : czy liczyć również jednomiany o wykładniku @p exp ?
+ * @return liczba jednomianów
+ */
+static size_t Gallop(const Mono *arr, size_t size, poly_exp_t exp,
+                     bool or_equal) {
+    size_t lo = 0, hi = 1;
+    while (hi <= size && (MonoGetExp(&arr[hi-1]) > exp ||
+                          (or_equal && MonoGetExp(&arr[hi-1]) == exp))) {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    if (hi > size) hi = size + 1;
+
+    // pierwsze `lo` jednomianów spełnia warunek, jednomian `hi - 1` nie
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (MonoGetExp(&arr[mid-1]) > exp ||
+            (or_equal && MonoGetExp(&arr[mid-1]) == exp)) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Scala dwie sąsiednie serie posortowane malejąco. Fragmenty serii, które
+ * trafiają do wyniku w całości, są znajdowane wyszukiwaniem wykładniczym
+ * i kopiowane naraz. Jednomiany o równych wykładnikach zachowują kolejność.
+ * @param[in,out] arr : tablica jednomianów; serie to `arr[0, mid)`
+ * i `arr[mid, size)`
+ * @param[in] mid : długość pierwszej serii
+ * @param[in] size : łączna długość serii
+ * @param[in] tmp : bufor na co najmniej @p mid jednomianów
+ */
+static void MergeMonoRuns(Mono *arr, size_t mid, size_t size, Mono *tmp) {
+    // początek pierwszej serii, nie mniejszy niż druga seria, jest na miejscu
+    size_t skip = Gallop(arr, mid, MonoGetExp(&arr[mid]), true);
+    arr += skip;
+    mid -= skip;
+    size -= skip;
+    if (mid == 0) return;
+
+    memcpy(tmp, arr, mid * sizeof(Mono));
+    const Mono *a = tmp;
+    Mono *b = arr + mid;
+    size_t na = mid, nb = size - mid, i = 0, j = 0, k = 0;
+
+    while (i < na && j < nb) {
+        if (MonoGetExp(&a[i]) >= MonoGetExp(&b[j])) {
+            size_t run = Gallop(a + i, na - i, MonoGetExp(&b[j]), true);
+            memcpy(arr + k, a + i, run * sizeof(Mono));
+            i += run;
+            k += run;
+        } else {
+            size_t run = Gallop(b + j, nb - j, MonoGetExp(&a[i]), false);
+            memmove(arr + k, b + j, run * sizeof(Mono));
+            j += run;
+            k += run;
+        }
+    }
+    // pozostała część drugiej serii jest już na swoim miejscu
+    memcpy(arr + k, a + i, (na - i) * sizeof(Mono));
+}
+
+/**
+ * Sortuje tablicę jednomianów pozycyjnie (LSD) względem wykładników, które
+ * muszą być nieujemne. Sortowane są 64-bitowe klucze złożone z wykładnika
+ * i indeksu jednomianu, a jednomiany są przenoszone tylko raz, na końcu.
+ * @param[in,out] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów, mniejsza niż @f$2^{32}@f$
+ */
+static void RadixSortMonos(Mono *arr, size_t size) {
+    uint64_t *keys = (uint64_t*) malloc(2 * size * sizeof(uint64_t));
+    Mono *sorted = (Mono*) malloc(size * sizeof(Mono));
+    CheckPtr(keys);
+    CheckPtr(sorted);
+    uint64_t *other = keys + size;
+
+    // klucze rosną, gdy wykładniki maleją
+    size_t counts[4][256] = {{0}};
+    for (size_t i = 0; i < size; i++) {
+        uint64_t key = (uint64_t) (INT_MAX - MonoGetExp(&arr[i]));
+        keys[i] = key << 32 | i;
+        for (size_t d = 0; d < 4; d++) {
+            counts[d][(key >> (8 * d)) & 0xff]++;
+        }
+    }
+
+    for (size_t d = 0; d < 4; d++) {
+        // przebieg, w którym wszystkie klucze mają tę samą cyfrę, jest zbędny
+        if (counts[d][(keys[0] >> (32 + 8 * d)) & 0xff] == size) continue;
+
+        size_t pos = 0;
+        for (size_t c = 0; c < 256; c++) {
+            size_t n = counts[d][c];
+            counts[d][c] = pos;
+            pos += n;
+        }
+        for (size_t i = 0; i < size; i++) {
+            other[counts[d][(keys[i] >> (32 + 8 * d)) & 0xff]++] = keys[i];
+        }
+        uint64_t *tmp = keys;
+        keys = other;
+        other = tmp;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        sorted[i] = arr[keys[i] & 0xffffffff];
+    }
+    memcpy(arr, sorted, size * sizeof(Mono));
+
+    free(keys < other ? keys : other);
+    free(sorted);
+}
+
+/**
+ * Sortuje tablicę jednomianów przez wstawianie.
+ * @param[in,out] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów
+ */
+static void InsertionSortMonos(Mono *arr, size_t size) {
+    for (size_t i = 1; i < size; i++) {
+        Mono m = arr[i];
+        size_t j = i;
+        while (j > 0 && MonoGetExp(&arr[j-1]) < MonoGetExp(&m)) {
+            arr[j] = arr[j-1];
+            j--;
+        }
+        arr[j] = m;
+    }
+}
+
+/**
+ * Sortuje tablicę jednomianów malejąco ze względu na wykładniki. Najpierw
+ * dzieli tablicę na serie (serie rosnące są odwracane), więc tablica już
+ * posortowana jest tylko raz przeglądana. Tablica złożona z niewielu długich
+ * serii, np. z połączenia dwóch posortowanych tablic, jest sortowana przez
+ * scalanie serii. Długie tablice o krótkich seriach są sortowane pozycyjnie,
+ * a krótkie - przez wstawianie.
+ *
  * @param[in] count : liczba jednomianów
  * @param[in] monos : tablica jednomianów
- */ 
-static void SortMonosArray(size_t count, const Mono monos[]) {
-    qsort((void*)monos, count, sizeof(Mono), CompareMonosExp);
+ */
+static void SortMonosArray(size_t count, Mono monos[]) {
+    size_t runs = 0;
+    bool ascending = false;
+    for (size_t i = 0; i < count; i += MonoRunLength(monos + i, count - i,
+                                                     &ascending)) {
+        runs++;
+    }
+
+    if (runs <= 1) {
+        if (count > 1 && ascending) ReverseMonoArray(monos, count);
+        return;
+    }
+
+    if (runs * MIN_MERGED_RUN > count) {
+        if (count < RADIX_SORT_MIN_SIZE) {
+            InsertionSortMonos(monos, count);
+            return;
+        }
+        bool non_negative = true;
+        for (size_t i = 0; i < count; i++) {
+            non_negative &= MonoGetExp(&monos[i]) >= 0;
+        }
+        if (non_negative && count <= UINT32_MAX) {
+            RadixSortMonos(monos, count);
+            return;
+        }
+    }
+
+    size_t *bounds = (size_t*) malloc((runs + 1) * sizeof(size_t));
+    Mono *tmp = (Mono*) malloc(count * sizeof(Mono));
+    CheckPtr(bounds);
+    CheckPtr(tmp);
+    size_t n = 0;
+    for (size_t i = 0; i < count;) {
+        size_t len = MonoRunLength(monos + i, count - i, &ascending);
+        if (ascending) ReverseMonoArray(monos + i, len);
+        bounds[n++] = i;
+        i += len;
+    }
+    bounds[n] = count;
+
+    // scalanie sąsiednich serii parami, aż zostanie jedna
+    while (n > 1) {
+        size_t m = 0;
+        for (size_t r = 0; r < n; r += 2) {
+            if (r + 1 < n) {
+                MergeMonoRuns(monos + bounds[r], bounds[r+1] - bounds[r],
+                              bounds[r+2] - bounds[r], tmp);
+            }
+            bounds[m++] = bounds[r];
+        }
+        bounds[m] = count;
+        n = m;
+    }
+
+    free(bounds);
+    free(tmp);
 }
 
 /**
@@ -97,6 +445,14 @@ poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
         return MonoGetExp(&p->arr[0]);
     }
 
+    size_t nvars = MonoArrayGetHeader(p->arr)->nvars;
+    if (var_idx >= nvars) {
+        return 0;
+    }
+    if (nvars <= MAX_CACHED_VAR_DEGS) {
+        return MonoArrayVarDegs(p->arr, p->size)[var_idx];
+    }
+
     poly_exp_t max_deg = 0;
 
     for (size_t i = 0; i < p->size ; i++) {
@@ -112,14 +468,44 @@ poly_exp_t PolyDeg(const Poly *p) {
         return PolyIsZero(p) ? -1 : 0;
     }
 
-    poly_exp_t max_deg = 0;
+    return MonoArrayGetHeader(p->arr)->deg;
+}
+
+/**
+ * Miesza bity liczby 64-bitowej (funkcja kończąca generatora SplitMix64).
+ * @param[in] x : liczba
+ * @return liczba o wymieszanych bitach
+ */
+static inline uint64_t HashMix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t PolyHash(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        return HashMix((uint64_t) p->coeff);
+    }
 
+    MonoArrayHeader *header = MonoArrayGetHeader(p->arr);
+    uint64_t hash = atomic_load_explicit(&header->hash, memory_order_relaxed);
+    if (hash != 0) return hash;
+
+    // wielomian, który nie jest stały, ma inny skrót niż stała
+    hash = HashMix(p->size + 0x9e3779b97f4a7c15ULL);
     for (size_t i = 0; i < p->size; i++) {
-        poly_exp_t tmp_deg = PolyDeg(&p->arr[i].p) + MonoGetExp(&p->arr[i]);
-        if (tmp_deg > max_deg) max_deg = tmp_deg;
+        hash = HashMix(hash ^ (uint64_t) MonoGetExp(&p->arr[i]));
+        hash = HashMix(hash + PolyHash(&p->arr[i].p));
     }
+    // 0 oznacza brak zapamiętanego skrótu
+    if (hash == 0) hash = 1;
 
-    return max_deg;
+    // skrót jest wyznaczony jednoznacznie, więc równoległe zapisy nie szkodzą
+    atomic_store_explicit(&header->hash, hash, memory_order_relaxed);
+    return hash;
 }
 
 bool PolyIsEq(const Poly *p, const Poly *q) {
@@ -135,6 +521,17 @@ bool PolyIsEq(const Poly *p, const Poly *q) {
         return false;
     }
 
+    // kopie wielomianu współdzielą tablicę jednomianów
+    if (p->arr == q->arr) {
+        return true;
+    }
+
+    // różne skróty wykluczają równość; po pierwszym porównaniu skróty obu
+    // wielomianów i ich współczynników są zapamiętane
+    if (PolyHash(p) != PolyHash(q)) {
+        return false;
+    }
+
     assert(
             MonoArrayIsSorted(p->arr, p->size) &&
             MonoArrayIsSimplified(p->arr, p->size)
@@ -151,20 +548,27 @@ bool PolyIsEq(const Poly *p, const Poly *q) {
     return true;
 }
 
+static Poly PolyFromSimplifiedMonosArray(size_t count, Mono monos[]);
+
 Poly PolyClone(const Poly *p) {
     if (PolyIsCoeff(p)) {
         return PolyFromCoeff(p->coeff);
     }
 
-    Mono *new_arr = (Mono*) calloc(p->size, sizeof(Mono));
-    CheckPtr(new_arr);
+    if (sharing) {
+        atomic_fetch_add_explicit(&MonoArrayGetHeader(p->arr)->refs, 1,
+                                  memory_order_relaxed);
+        return *p;
+    }
+
+    Mono *new_arr = MonoArrayAlloc(p->size);
 
     for (size_t i = 0; i < p->size; i++) {
         Poly new_poly = PolyClone(&(p->arr[i].p));
         new_arr[i] = MonoFromPoly(&new_poly, MonoGetExp(&p->arr[i]));
     }
 
-    return (Poly) {.size = p->size, .arr = new_arr};
+    return PolyFromSimplifiedMonosArray(p->size, new_arr);
 }
 
 void DestroyMonoArray(Mono *arr, size_t size) {
@@ -176,30 +580,50 @@ void DestroyMonoArray(Mono *arr, size_t size) {
 
 void PolyDestroy(Poly *p) {
     if (!PolyIsCoeff(p)) {
-        DestroyMonoArray(p->arr, p->size);
+        MonoArrayRelease(p->arr, p->size);
     }
 }
 
 /**
- * Przesuwa elementy tablicy jednomianów w lewo o 1, rozpoczynając od zadanego
- * indeksu @p pos . Usuwa z pamięci jednomian na tej pozycji.
- *
- * @param[in] arr : tablica jednomianów
- * @param[in] size : liczba jednomianów
- * @param[in] pos : indeks tablicy, od którego rozpoczyna się przesunięcie
+ * Robi kopię tablicy jednomianów.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return skopiowana tablica jednomianów
  */
-static void ShiftMonoArray(Mono *arr, size_t size, size_t pos) {
-    MonoDestroy(&arr[pos]);
+static Mono* CloneMonoArray(size_t count, const Mono monos[]) {
+    Mono *new_arr = MonoArrayAlloc(count);
+    for (size_t i = 0; i < count; i++) {
+        new_arr[i] = MonoClone(&monos[i]);
+    }
+    return new_arr;
+}
 
-    for (size_t i = pos; i < size-1; i++) {
-        arr[i] = arr[i+1];
+/**
+ * Zapewnia, że tablica jednomianów wielomianu nie jest współdzielona z innymi
+ * wielomianami, w razie potrzeby zastępując ją kopią. Musi zostać wywołana
+ * przed modyfikacją tablicy w miejscu, ponieważ unieważnia zapamiętany
+ * skrót wielomianu. Współczynniki jednomianów mogą nadal być współdzielone.
+ * @param[in,out] p : wielomian, który nie jest stały
+ */
+static void PolyMakeUnique(Poly *p) {
+    MonoArrayHeader *header = MonoArrayGetHeader(p->arr);
+    if (atomic_load_explicit(&header->refs, memory_order_acquire) == 1) {
+        atomic_store_explicit(&header->hash, 0, memory_order_relaxed);
+        return;
     }
+
+    Mono *new_arr = CloneMonoArray(p->size, p->arr);
+    MonoArrayRelease(p->arr, p->size);
+    p->arr = new_arr;
 }
 
 /**
  * Upraszcza tablicę jednomianów, sumując współczynniki przy jednomianach o
  * tym samym wykładniku. W razie potrzeby usuwa z pamięci zbędne jednomiany,
  * modyfikuje tablicę @p arr i zmienia wartość zmiennej @p size .
+ * Po posortowaniu tablica jest przeglądana raz: kursor odczytu sumuje serie
+ * jednomianów o równych wykładnikach, a kursor zapisu zapisuje niezerowe
+ * sumy, więc koszt jest liniowy niezależnie od liczby skróceń.
  *
  * @param[in] arr : tablica jednomianów
  * @param[in] size : liczba jednomianów
@@ -207,45 +631,35 @@ static void ShiftMonoArray(Mono *arr, size_t size, size_t pos) {
 static void SimplifyMonoArray(Mono *arr, size_t *size) {
     SortMonosArray(*size, arr);
 
-    // dodawanie do siebie jednomianów o tym samym wykładniku
-    size_t i = 1;
-    while (i < *size) {
-        if (MonoGetExp(&arr[i]) == MonoGetExp(&arr[i-1])) {
-            Poly tmp_poly = PolyAdd(&arr[i-1].p, &arr[i].p);
-            PolyDestroy(&arr[i-1].p);
-            arr[i-1].p = tmp_poly;
-            ShiftMonoArray(arr, *size, i);
-            (*size)--;
-        } else {
-            i++;
+    size_t w = 0;
+    for (size_t r = 0; r < *size;) {
+        Mono m = arr[r++];
+        while (r < *size && MonoGetExp(&arr[r]) == MonoGetExp(&m)) {
+            PolyAddAssign(&m.p, &arr[r++].p);
         }
-    }
 
-    // usuwanie zerowych jednomianów z tablicy
-    size_t j = 0;
-    while (j < *size) {
-        if (PolyIsZero(&arr[j].p)) {
-            MonoDestroy(&arr[j]);
-            ShiftMonoArray(arr, *size, j);
-            (*size)--;
+        if (PolyIsZero(&m.p)) {
+            MonoDestroy(&m);
         } else {
-            j++;
+            arr[w++] = m;
         }
     }
+    *size = w;
 }
 
 /**
  * Funkcja generująca wielomian z listy jednomianów z założeniem,
  * że lista ta jest posortowana malejąco ze względu na wykładniki
- * oraz nie zawiera jednomianów zerowych.
+ * oraz nie zawiera jednomianów zerowych. Oblicza stopień wielomianu
+ * i stopnie ze względu na zmienne ze stopni współczynników jednomianów.
  *
  * @param[in] count : liczba jednomianów
  * @param[in] monos : tablica jednomianów
  * @return : wielomian będący sumą jednomianów
  */ 
 static Poly PolyFromSimplifiedMonosArray(size_t count, Mono monos[]) {
-     if (count == 0) {
-        free(monos);
+    if (count == 0) {
+        MonoArrayFree(monos);
         return PolyZero();
     }
 
@@ -254,7 +668,7 @@ static Poly PolyFromSimplifiedMonosArray(size_t count, Mono monos[]) {
         PolyIsCoeff(&monos[0].p)
         ) {
         Poly res = PolyFromCoeff(monos[0].p.coeff);
-        DestroyMonoArray(monos, count);
+        MonoArrayFree(monos);
         return res;
     }
 
@@ -263,12 +677,128 @@ static Poly PolyFromSimplifiedMonosArray(size_t count, Mono monos[]) {
             MonoArrayIsSimplified(monos, count)
     );
 
-    monos = (Mono*) realloc(monos, count * sizeof(Mono));
-    CheckPtr(monos);
+    size_t nvars = 1;
+    poly_exp_t deg = 0;
+    for (size_t i = 0; i < count; i++) {
+        const Poly *coeff = &monos[i].p;
+        if (!PolyIsCoeff(coeff) &&
+            MonoArrayGetHeader(coeff->arr)->nvars + 1 > nvars)
+        {
+            nvars = MonoArrayGetHeader(coeff->arr)->nvars + 1;
+        }
+        if (PolyDeg(coeff) + MonoGetExp(&monos[i]) > deg) {
+            deg = PolyDeg(coeff) + MonoGetExp(&monos[i]);
+        }
+    }
+
+    // stopnie ze względu na zmienne są zapisywane za jednomianami, w pamięci
+    // zajmującej `extra` jednomianów; wielomiany jednej zmiennej ich nie
+    // potrzebują
+    bool cache_degs = nvars > 1 && nvars <= MAX_CACHED_VAR_DEGS;
+    size_t extra = !cache_degs ? 0 :
+        (nvars * sizeof(poly_exp_t) + sizeof(Mono) - 1) / sizeof(Mono);
+    monos = MonoArrayRealloc(monos, count + extra);
+    MonoArrayHeader *header = MonoArrayGetHeader(monos);
+    header->nvars = nvars;
+    header->deg = deg;
+
+    if (cache_degs) {
+        poly_exp_t *degs = MonoArrayVarDegs(monos, count);
+        for (size_t j = 1; j < nvars; j++) {
+            degs[j] = 0;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const Poly *coeff = &monos[i].p;
+            if (PolyIsCoeff(coeff)) continue;
+            size_t coeff_nvars = MonoArrayGetHeader(coeff->arr)->nvars;
+            for (size_t j = 0; j < coeff_nvars; j++) {
+                if (PolyDegBy(coeff, j) > degs[j+1]) {
+                    degs[j+1] = PolyDegBy(coeff, j);
+                }
+            }
+        }
+    }
 
     return (Poly) {.arr = monos, .size = count};
 }
 
+/**
+ * Mnoży wielomian przez stałą, modyfikując go w miejscu. Usuwa z pamięci
+ * jednomiany, których współczynniki stały się zerowe.
+ *
+ * @param[in,out] p : wielomian @f$p@f$, zastępowany przez @f$cp@f$
+ * @param[in] c : stała @f$c@f$
+ */
+static void PolyMulByCoeffAssign(Poly *p, poly_coeff_t c) {
+    if (c == 1) return;
+
+    if (c == 0) {
+        PolyDestroy(p);
+        *p = PolyZero();
+        return;
+    }
+
+    if (PolyIsCoeff(p)) {
+        p->coeff = c * p->coeff;
+        return;
+    }
+
+    PolyMakeUnique(p);
+
+    size_t k = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        PolyMulByCoeffAssign(&p->arr[i].p, c);
+        if (!PolyIsZero(&p->arr[i].p)) {
+            p->arr[k++] = p->arr[i];
+        }
+    }
+
+    *p = PolyFromSimplifiedMonosArray(k, p->arr);
+}
+
+/**
+ * Scala dwie posortowane malejąco względem wykładników i uproszczone tablice
+ * jednomianów w jeden wielomian będący ich sumą. Jednomiany o tym samym
+ * wykładniku są dodawane rekurencyjnie, a jednomiany zerowe są pomijane.
+ * Nie modyfikuje tablic @p a i @p b, wykonuje kopie ich jednomianów.
+ *
+ * @param[in] a : tablica jednomianów @f$a@f$
+ * @param[in] a_size : liczba jednomianów w tablicy @f$a@f$
+ * @param[in] b : tablica jednomianów @f$b@f$
+ * @param[in] b_size : liczba jednomianów w tablicy @f$b@f$
+ * @return wielomian będący sumą jednomianów z obu tablic
+ */
+static Poly MergeMonoArrays(const Mono *a, size_t a_size,
+                            const Mono *b, size_t b_size) {
+    Mono *new_arr = MonoArrayAlloc(a_size + b_size);
+
+    size_t i = 0, j = 0, k = 0;
+    while (i < a_size && j < b_size) {
+        poly_exp_t a_exp = MonoGetExp(&a[i]);
+        poly_exp_t b_exp = MonoGetExp(&b[j]);
+
+        if (a_exp > b_exp) {
+            new_arr[k++] = MonoClone(&a[i++]);
+        } else if (a_exp < b_exp) {
+            new_arr[k++] = MonoClone(&b[j++]);
+        } else {
+            Poly sum = PolyAdd(&a[i++].p, &b[j++].p);
+            if (!PolyIsZero(&sum)) {
+                new_arr[k++] = MonoFromPoly(&sum, a_exp);
+            }
+        }
+    }
+
+    while (i < a_size) {
+        new_arr[k++] = MonoClone(&a[i++]);
+    }
+    while (j < b_size) {
+        new_arr[k++] = MonoClone(&b[j++]);
+    }
+
+    return PolyFromSimplifiedMonosArray(k, new_arr);
+}
+
 Poly PolyAdd(const Poly *p, const Poly *q) {
     if (PolyIsZero(p)) return PolyClone(q);
     if (PolyIsZero(q)) return PolyClone(p);
@@ -284,30 +814,15 @@ Poly PolyAdd(const Poly *p, const Poly *q) {
         return PolyAdd(q, p);
     }
 
-    // kopiowanie zawartosci wielomianow p i q do nowej tablicy
-    size_t new_size = p->size + (q_is_coeff ? 1 : q->size);
-    Mono *new_array = (Mono*) calloc(new_size, sizeof(Mono));
-    CheckPtr(new_array);
-
-    for (size_t i = 0; i < p->size; i++) {
-        new_array[i] = MonoClone(&(p->arr[i]));
-    }
-    
+    // wielomian stały jest traktowany jak jednomian o wykładniku 0
     if (q_is_coeff) {
-        Poly q_clone = PolyClone(q);
-        new_array[p->size] = MonoFromPoly(&q_clone, 0);
-    } else {
-        for (size_t i = 0; p->size+i < new_size; i++) {
-            new_array[p->size + i] = MonoClone(&q->arr[i]);
-        }
+        Mono q_mono = MonoFromPoly(q, 0);
+        return MergeMonoArrays(p->arr, p->size, &q_mono, 1);
     }
 
-    SimplifyMonoArray(new_array, &new_size);
-
-    return PolyFromSimplifiedMonosArray(new_size, new_array);
+    return MergeMonoArrays(p->arr, p->size, q->arr, q->size);
 }
 
-
 Poly PolySub(const Poly *p, const Poly *q) {
     Poly q_neg = PolyNeg(q);
     Poly res = PolyAdd(p, &q_neg);
@@ -315,13 +830,93 @@ Poly PolySub(const Poly *p, const Poly *q) {
     return res;
 }
 
+/**
+ * Dodaje do wielomianu @p acc jednomiany z posortowanej malejąco względem
+ * wykładników i uproszczonej tablicy @p monos , scalając je od końca
+ * w miejscu. Przejmuje na własność jednomiany z tablicy @p monos , ale nie
+ * zwalnia samej tablicy. Wielomian @p acc nie może być stały.
+ *
+ * @param[in,out] acc : wielomian, do którego dodawane są jednomiany
+ * @param[in] monos : tablica jednomianów
+ * @param[in] count : liczba jednomianów
+ */
+static void MergeMonoArrayInto(Poly *acc, Mono *monos, size_t count) {
+    size_t i = acc->size, j = count, k = acc->size + count;
+    size_t total = k;
+
+    PolyMakeUnique(acc);
+    Mono *arr = MonoArrayRealloc(acc->arr, total);
+
+    // scalanie od najmniejszych wykładników, wynik jest zapisywany na końcu
+    // tablicy, więc nie nadpisuje nieprzetworzonych jednomianów z `acc`
+    while (i > 0 && j > 0) {
+        poly_exp_t a_exp = MonoGetExp(&arr[i-1]);
+        poly_exp_t b_exp = MonoGetExp(&monos[j-1]);
+
+        if (a_exp < b_exp) {
+            arr[--k] = arr[--i];
+        } else if (a_exp > b_exp) {
+            arr[--k] = monos[--j];
+        } else {
+            PolyAddAssign(&arr[i-1].p, &monos[--j].p);
+            arr[--k] = arr[--i];
+        }
+    }
+
+    while (j > 0) {
+        arr[--k] = monos[--j];
+    }
+
+    // usuwanie luki powstałej przez sumowanie oraz zerowych jednomianów
+    size_t w = i;
+    for (size_t r = k; r < total; r++) {
+        if (!PolyIsZero(&arr[r].p)) {
+            arr[w++] = arr[r];
+        }
+    }
+
+    *acc = PolyFromSimplifiedMonosArray(w, arr);
+}
+
+void PolyAddAssign(Poly *acc, Poly *take) {
+    if (PolyIsZero(take)) return;
+
+    if (PolyIsCoeff(acc)) {
+        Poly tmp = *acc;
+        *acc = *take;
+        *take = tmp;
+        if (PolyIsCoeff(acc)) {
+            acc->coeff += take->coeff;
+            *take = PolyZero();
+            return;
+        }
+        if (PolyIsZero(take)) return;
+    }
+
+    if (PolyIsCoeff(take)) {
+        // wielomian stały jest traktowany jak jednomian o wykładniku 0
+        Mono m = MonoFromPoly(take, 0);
+        MergeMonoArrayInto(acc, &m, 1);
+    } else {
+        PolyMakeUnique(take);
+        MergeMonoArrayInto(acc, take->arr, take->size);
+        MonoArrayFree(take->arr);
+    }
+
+    *take = PolyZero();
+}
+
+void PolySubAssign(Poly *acc, Poly *take) {
+    PolyMulByCoeffAssign(take, -1);
+    PolyAddAssign(acc, take);
+}
+
 Poly PolyAddMonos(size_t count, const Mono monos[]) {
     if (count == 0) {
         return PolyZero();
     }
 
-    Mono *new_arr = (Mono*) calloc(count, sizeof(Mono));
-    CheckPtr(new_arr);
+    Mono *new_arr = MonoArrayAlloc(count);
     memcpy(new_arr, monos, count * sizeof(Mono));
 
     size_t new_size = count;
@@ -335,22 +930,11 @@ Poly PolyOwnMonos(size_t count, Mono *monos) {
         return PolyZero();
     }
 
-    SimplifyMonoArray(monos, &count);
-    return PolyFromSimplifiedMonosArray(count, monos);
-}
-
-/**
- * Robi głęboką kopię tablicy jednomianów.
- * @param[in] count : liczba jednomianów
- * @param[in] monos : tablica jednomianów
- * @return skopiowana tablica jednomianów
- */
-static Mono* CloneMonoArray(size_t count, const Mono monos[]) {
-    Mono *new_arr = (Mono*) calloc(count, sizeof(Mono));
-    for (size_t i = 0; i < count; i++) {
-        new_arr[i] = MonoClone(&monos[i]);
-    }
-    return new_arr;
+    // tablica wielomianu musi być poprzedzona nagłówkiem, więc jednomiany
+    // są przenoszone do nowej tablicy
+    Poly res = PolyAddMonos(count, monos);
+    free(monos);
+    return res;
 }
 
 Poly PolyCloneMonos(size_t count, const Mono monos[]) {
@@ -359,31 +943,175 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]) {
     }
 
     Mono *monos_clone = CloneMonoArray(count, monos);
-    return PolyOwnMonos(count, monos_clone);
+    SimplifyMonoArray(monos_clone, &count);
+    return PolyFromSimplifiedMonosArray(count, monos_clone);
 }
 
+/** Początkowy rozmiar bufora jednomianów budowniczego wielomianu. */
+#define BUILDER_INITIAL_SIZE 4
+
 /**
- * Modyfikuje rekurencyjnie współczynniki wielomianu, mnożąc współczynniki
- * o wartościach liczbowych przez stałą. Sprawdza, czy przy mnożeniu nie
- * nastąpił błąd.
- *
- * @param[in] p : wielomian
- * @param[in] c : stała
- * @return : czy modyfikacja wielomianu zakończyła się powodzeniem?
- */ 
-static bool PolyMulCoeffs(Poly *p, poly_coeff_t c) {
-    if (PolyIsCoeff(p)) {
-        p->coeff = c * p->coeff;
-        return p->coeff != 0;
-    } 
+ * Rozmiar, od którego bufor jednomianów o niemonotonicznych wykładnikach
+ * jest zamieniany w serię zamiast powiększany.
+ */
+#define BUILDER_BUFFER_SIZE 64
 
-    for (size_t i = 0; i < p->size; i++) {
-        if (!PolyMulCoeffs(&p->arr[i].p, c)) {
-            return false;
+/**
+ * Największa liczba poziomów serii budowniczego; seria na poziomie @f$i@f$
+ * powstaje z @f$2^i@f$ buforów, więc poziomów nie zabraknie.
+ */
+#define BUILDER_MAX_LEVELS 64
+
+/**
+ * Struktura budowniczego wielomianu. Serie są przechowywane jako
+ * wielomiany, więc scalanie serii sumuje jednomiany o równych wykładnikach
+ * i pomija te, które się skracają. Dopóki jednomiany w buforze mają
+ * monotoniczne wykładniki, bufor jest powiększany zamiast zamieniany
+ * w serię, więc jednomiany podawane w kolejności wykładników nie są
+ * scalane wielokrotnie, a jeśli żadna seria nie powstała, bufor staje się
+ * tablicą jednomianów wyniku bez kopiowania i sortowania.
+ */
+struct PolyBuilder {
+    Mono *buffer;                    ///< jednomiany jeszcze niescalone
+    size_t count;                    ///< liczba jednomianów w buforze
+    size_t capacity;                 ///< rozmiar bufora
+    bool monotone;                   ///< czy wykładniki w buforze są
+                                     ///< ściśle monotoniczne?
+    bool descending;                 ///< czy są malejące (gdy `count > 1`)?
+    size_t nlevels;                  ///< liczba używanych poziomów
+    Poly levels[BUILDER_MAX_LEVELS]; ///< serie; zero oznacza brak serii
+};
+
+PolyBuilder *PolyBuilderBegin(void) {
+    PolyBuilder *b = (PolyBuilder*) malloc(sizeof(PolyBuilder));
+    CheckPtr(b);
+    b->buffer = NULL;
+    b->count = 0;
+    b->capacity = 0;
+    b->monotone = true;
+    b->nlevels = 0;
+    return b;
+}
+
+/**
+ * Zamienia bufor budowniczego w serię i scala ją z seriami kolejnych
+ * poziomów, tak jak przy zwiększaniu licznika binarnego.
+ * @param[in,out] b : budowniczy wielomianu
+ */
+static void PolyBuilderFlush(PolyBuilder *b) {
+    if (b->count == 0) return;
+
+    SimplifyMonoArray(b->buffer, &b->count);
+    Poly run = PolyFromSimplifiedMonosArray(b->count, b->buffer);
+    b->buffer = NULL;
+    b->count = 0;
+    b->capacity = 0;
+    b->monotone = true;
+
+    size_t level = 0;
+    while (level < b->nlevels && !PolyIsZero(&b->levels[level])) {
+        PolyAddAssign(&run, &b->levels[level]);
+        level++;
+    }
+    assert(level < BUILDER_MAX_LEVELS);
+    if (level == b->nlevels) {
+        b->nlevels++;
+    }
+    b->levels[level] = run;
+}
+
+void PolyBuilderAddMono(PolyBuilder *b, Mono *m) {
+    if (PolyIsZero(&m->p)) return;
+
+    // jednomiany podawane w kolejności wykładników są sumowane od razu
+    if (b->count > 0 &&
+        MonoGetExp(&b->buffer[b->count - 1]) == MonoGetExp(m)) {
+        PolyAddAssign(&b->buffer[b->count - 1].p, &m->p);
+        if (PolyIsZero(&b->buffer[b->count - 1].p)) {
+            b->count--;
         }
+        return;
     }
 
-    return true;
+    if (b->count > 0 && b->monotone) {
+        bool descending =
+            MonoGetExp(&b->buffer[b->count - 1]) > MonoGetExp(m);
+        if (b->count == 1) {
+            b->descending = descending;
+        } else if (descending != b->descending) {
+            b->monotone = false;
+        }
+    }
+
+    if (b->count == b->capacity && !b->monotone &&
+        b->capacity >= BUILDER_BUFFER_SIZE) {
+        PolyBuilderFlush(b);
+    }
+    if (b->count == b->capacity) {
+        if (b->buffer == NULL) {
+            b->capacity = BUILDER_INITIAL_SIZE;
+            b->buffer = MonoArrayAlloc(b->capacity);
+        } else {
+            b->buffer = MonoArrayRealloc(b->buffer, 2 * b->capacity);
+            b->capacity *= 2;
+        }
+    }
+    b->buffer[b->count++] = *m;
+}
+
+void PolyBuilderAddTerm(PolyBuilder *b, size_t k, const poly_exp_t exps[],
+                        poly_coeff_t coeff) {
+    if (coeff == 0) return;
+
+    Poly p = PolyFromCoeff(coeff);
+    for (size_t i = k; i-- > 1;) {
+        Mono m = MonoFromPoly(&p, exps[i]);
+        p = PolyAddMonos(1, &m);
+    }
+
+    Mono m = MonoFromPoly(&p, k == 0 ? 0 : exps[0]);
+    PolyBuilderAddMono(b, &m);
+}
+
+Poly PolyBuilderFinish(PolyBuilder *b) {
+    if (b->nlevels == 0 && b->monotone) {
+        Poly res = PolyZero();
+        if (b->count > 0) {
+            if (b->count > 1 && !b->descending) {
+                ReverseMonoArray(b->buffer, b->count);
+            }
+            res = PolyFromSimplifiedMonosArray(b->count, b->buffer);
+        } else if (b->buffer != NULL) {
+            MonoArrayFree(b->buffer);
+        }
+        free(b);
+        return res;
+    }
+
+    PolyBuilderFlush(b);
+    if (b->buffer != NULL) {
+        MonoArrayFree(b->buffer);
+    }
+
+    Poly res = PolyZero();
+    for (size_t i = 0; i < b->nlevels; i++) {
+        PolyAddAssign(&res, &b->levels[i]);
+    }
+    free(b);
+    return res;
+}
+
+void PolyBuilderDestroy(PolyBuilder *b) {
+    for (size_t i = 0; i < b->count; i++) {
+        MonoDestroy(&b->buffer[i]);
+    }
+    if (b->buffer != NULL) {
+        MonoArrayFree(b->buffer);
+    }
+    for (size_t i = 0; i < b->nlevels; i++) {
+        PolyDestroy(&b->levels[i]);
+    }
+    free(b);
 }
 
 /**
@@ -395,16 +1123,9 @@ static bool PolyMulCoeffs(Poly *p, poly_coeff_t c) {
  */ 
 static Poly PolyMulByCoeff(const Poly *p, poly_coeff_t c) {
     if (c == 0) return PolyZero();
-    if (c == 1) return PolyClone(p);
-    if (PolyIsCoeff(p)) return PolyFromCoeff(p->coeff * c);
-
 
     Poly new_poly = PolyClone(p);
-    if (!PolyMulCoeffs(&new_poly, c)) {
-        PolyDestroy(&new_poly);
-        return PolyZero();
-    } 
-    
+    PolyMulByCoeffAssign(&new_poly, c);
     return new_poly;
 }
 
@@ -412,32 +1133,1180 @@ Poly PolyNeg(const Poly *p) {
     return PolyMulByCoeff(p, -1);
 }
 
-Poly PolyMul(const Poly *p, const Poly *q) {
-    if (PolyIsCoeff(p)) return PolyMulByCoeff(q, p->coeff);
-    if (PolyIsCoeff(q)) return PolyMulByCoeff(p, q->coeff);
+/**
+ * Sprawdza, czy wszystkie współczynniki jednomianów w tablicy są stałe.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : liczba jednomianów
+ * @return czy wszystkie współczynniki są wielomianami stałymi?
+ */
+static bool MonoArrayHasCoeffsOnly(const Mono *arr, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (!PolyIsCoeff(&arr[i].p)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // mnożenie dwóch wielomianów stopnia > 0
-    Mono *new_arr = (Mono*) calloc(p->size * q->size, sizeof(Mono));
-    CheckPtr(new_arr);
+/**
+ * Element kopca używanego przy mnożeniu wielomianów. Reprezentuje iloczyn
+ * jednomianu o indeksie @p i z krótszego czynnika i jednomianu o indeksie
+ * @p j z dłuższego czynnika.
+ */
+typedef struct MulHeapEntry {
+    poly_exp_t exp; ///< wykładnik iloczynu jednomianów
+    size_t i;       ///< indeks jednomianu w krótszym czynniku
+    size_t j;       ///< indeks jednomianu w dłuższym czynniku
+} MulHeapEntry;
+
+/**
+ * Przywraca własność kopca typu max (względem wykładnika) dla poddrzewa
+ * o korzeniu w elemencie o indeksie @p pos .
+ *
+ * @param[in] heap : tablica reprezentująca kopiec
+ * @param[in] size : liczba elementów kopca
+ * @param[in] pos : indeks przesuwanego w dół elementu
+ */
+static void MulHeapSiftDown(MulHeapEntry *heap, size_t size, size_t pos) {
+    MulHeapEntry entry = heap[pos];
+
+    while (2 * pos + 1 < size) {
+        size_t child = 2 * pos + 1;
+        if (child + 1 < size && heap[child + 1].exp > heap[child].exp) {
+            child++;
+        }
+        if (heap[child].exp <= entry.exp) {
+            break;
+        }
+        heap[pos] = heap[child];
+        pos = child;
+    }
+
+    heap[pos] = entry;
+}
+
+/**
+ * Dopisuje jednomian na koniec tablicy wynikowej, w razie potrzeby
+ * powiększając ją. Przejmuje na własność współczynnik @p p . Jeśli jest on
+ * tożsamościowo równy zeru, to usuwa go i nie zmienia tablicy.
+ *
+ * @param[in] arr : adres tablicy jednomianów
+ * @param[in] size : adres liczby jednomianów w tablicy
+ * @param[in] capacity : adres rozmiaru zaalokowanej tablicy
+ * @param[in] p : współczynnik jednomianu
+ * @param[in] exp : wykładnik jednomianu
+ */
+static void AppendMono(Mono **arr, size_t *size, size_t *capacity,
+                       Poly *p, poly_exp_t exp) {
+    if (PolyIsZero(p)) {
+        return;
+    }
+
+    if (*size == *capacity) {
+        *capacity = 1 + 2 * *capacity;
+        *arr = MonoArrayRealloc(*arr, *capacity);
+    }
+
+    (*arr)[(*size)++] = MonoFromPoly(p, exp);
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące stałymi. Iloczyny jednomianów są
+ * generowane malejąco względem wykładnika za pomocą kopca, w którym dla
+ * każdego jednomianu krótszego czynnika jest co najwyżej jeden element.
+ *
+ * @param[in] p : wielomian @f$p@f$, nie dłuższy niż @f$q@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulHeap(const Poly *p, const Poly *q) {
+    size_t heap_size = p->size;
+    MulHeapEntry *heap =
+        (MulHeapEntry*) calloc(heap_size, sizeof(MulHeapEntry));
+    CheckPtr(heap);
+
+    for (size_t i = 0; i < heap_size; i++) {
+        heap[i] = (MulHeapEntry) {
+            .exp = MonoGetExp(&p->arr[i]) + MonoGetExp(&q->arr[0]),
+            .i = i,
+            .j = 0
+        };
+    }
+    // jednomiany są posortowane malejąco, więc tablica jest już kopcem
+
+    size_t res_size = 0;
+    size_t res_capacity = p->size + q->size;
+    Mono *res_arr = MonoArrayAlloc(res_capacity);
+
+    poly_exp_t acc_exp = heap[0].exp;
+    Poly acc = PolyZero();
+
+    while (heap_size > 0) {
+        MulHeapEntry top = heap[0];
+
+        if (top.exp != acc_exp) {
+            AppendMono(&res_arr, &res_size, &res_capacity, &acc, acc_exp);
+            acc = PolyZero();
+            acc_exp = top.exp;
+        }
+
+        const Poly *a = &p->arr[top.i].p;
+        const Poly *b = &q->arr[top.j].p;
+        if (PolyIsCoeff(a) && PolyIsCoeff(b) && PolyIsCoeff(&acc)) {
+            acc.coeff += a->coeff * b->coeff;
+        } else {
+            Poly prod = PolyMul(a, b);
+            PolyAddAssign(&acc, &prod);
+        }
+
+        if (top.j + 1 < q->size) {
+            heap[0].j++;
+            heap[0].exp = MonoGetExp(&p->arr[top.i]) +
+                          MonoGetExp(&q->arr[top.j + 1]);
+        } else {
+            heap[0] = heap[--heap_size];
+        }
+        MulHeapSiftDown(heap, heap_size, 0);
+    }
+
+    AppendMono(&res_arr, &res_size, &res_capacity, &acc, acc_exp);
+    free(heap);
+
+    return PolyFromSimplifiedMonosArray(res_size, res_arr);
+}
+
+/**
+ * Element tablicy haszującej używanej przy mnożeniu wielomianów.
+ * Przechowuje sumę iloczynów współczynników o danym wykładniku.
+ */
+typedef struct MulHashSlot {
+    bool used;      ///< czy element jest zajęty?
+    poly_exp_t exp; ///< wykładnik iloczynów jednomianów
+    Poly acc;       ///< suma współczynników iloczynów o tym wykładniku
+} MulHashSlot;
+
+/**
+ * Tablica haszująca z adresowaniem otwartym używana przy mnożeniu
+ * wielomianów. Pojemność jest potęgą dwójki.
+ */
+typedef struct MulHashTable {
+    MulHashSlot *slots; ///< elementy tablicy
+    size_t capacity;    ///< liczba elementów tablicy
+    unsigned shift;     ///< przesunięcie w haszowaniu, `64 - log2(capacity)`
+    size_t used;        ///< liczba zajętych elementów
+} MulHashTable;
+
+/**
+ * Znajduje element tablicy haszującej dla danego wykładnika: element, który
+ * go przechowuje, albo wolny element, w którym należy go umieścić.
+ * @param[in] t : tablica haszująca
+ * @param[in] exp : wykładnik
+ * @return indeks elementu
+ */
+static size_t MulHashFind(const MulHashTable *t, poly_exp_t exp) {
+    // haszowanie Fibonacciego, kolejne próby liniowo
+    size_t pos = (size_t)
+        (((uint64_t) exp * UINT64_C(0x9E3779B97F4A7C15)) >> t->shift);
+    while (t->slots[pos].used && t->slots[pos].exp != exp) {
+        pos = (pos + 1) & (t->capacity - 1);
+    }
+    return pos;
+}
+
+/**
+ * Tworzy pustą tablicę haszującą o pojemności będącej najmniejszą potęgą
+ * dwójki nie mniejszą niż @p min_capacity i niż 2.
+ * @param[out] t : tablica haszująca
+ * @param[in] min_capacity : minimalna pojemność
+ */
+static void MulHashInit(MulHashTable *t, size_t min_capacity) {
+    t->capacity = 2;
+    t->shift = 63;
+    while (t->capacity < min_capacity) {
+        t->capacity *= 2;
+        t->shift--;
+    }
+    t->slots = (MulHashSlot*) calloc(t->capacity, sizeof(MulHashSlot));
+    CheckPtr(t->slots);
+    t->used = 0;
+}
+
+/**
+ * Podwaja pojemność tablicy haszującej, przenosząc jej elementy.
+ * @param[in,out] t : tablica haszująca
+ */
+static void MulHashGrow(MulHashTable *t) {
+    MulHashTable old = *t;
+    MulHashInit(t, 2 * old.capacity);
+    for (size_t k = 0; k < old.capacity; k++) {
+        if (old.slots[k].used) {
+            t->slots[MulHashFind(t, old.slots[k].exp)] = old.slots[k];
+        }
+    }
+    t->used = old.used;
+    free(old.slots);
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące stałymi, sumując iloczyny jednomianów
+ * w tablicy haszującej z adresowaniem otwartym, w której kluczem jest
+ * wykładnik. Sortowane są tylko jednomiany wyniku, a nie wszystkie iloczyny.
+ * Tablica rośnie wraz z liczbą różnych wykładników, więc jej rozmiar zależy
+ * od rozmiaru wyniku, a nie od szerokości przedziału wykładników.
+ *
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] range : ograniczenie górne liczby różnych wykładników iloczynów
+ * jednomianów, większe od zera
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulHash(const Poly *p, const Poly *q, size_t range) {
+    // tablica jest zapełniona co najwyżej w połowie; początkowo mieści tyle
+    // wykładników, ile jednomianów mają czynniki razem
+    size_t expected = p->size + q->size;
+    MulHashTable table;
+    MulHashInit(&table, 2 * (expected < range ? expected : range));
 
-    size_t k = 0;
     for (size_t i = 0; i < p->size; i++) {
         for (size_t j = 0; j < q->size; j++) {
-            Poly tmp_poly = PolyMul(&p->arr[i].p, &q->arr[j].p);
-            poly_exp_t tmp_exp = MonoGetExp(&p->arr[i])+MonoGetExp(&q->arr[j]);
+            poly_exp_t exp = MonoGetExp(&p->arr[i]) + MonoGetExp(&q->arr[j]);
+
+            size_t pos = MulHashFind(&table, exp);
+            if (!table.slots[pos].used) {
+                if (2 * (table.used + 1) > table.capacity) {
+                    MulHashGrow(&table);
+                    pos = MulHashFind(&table, exp);
+                }
+                table.slots[pos] = (MulHashSlot) {
+                    .used = true, .exp = exp, .acc = PolyZero()
+                };
+                table.used++;
+            }
+
+            const Poly *a = &p->arr[i].p;
+            const Poly *b = &q->arr[j].p;
+            Poly *acc = &table.slots[pos].acc;
+            if (PolyIsCoeff(a) && PolyIsCoeff(b) && PolyIsCoeff(acc)) {
+                acc->coeff += a->coeff * b->coeff;
+            } else {
+                Poly prod = PolyMul(a, b);
+                PolyAddAssign(acc, &prod);
+            }
+        }
+    }
+
+    Mono *res_arr = MonoArrayAlloc(table.used);
+    size_t res_size = 0;
+    for (size_t k = 0; k < table.capacity; k++) {
+        MulHashSlot *slot = &table.slots[k];
+        if (slot->used && !PolyIsZero(&slot->acc)) {
+            res_arr[res_size++] = MonoFromPoly(&slot->acc, slot->exp);
+        }
+    }
+    free(table.slots);
+
+    SortMonosArray(res_size, res_arr);
+    return PolyFromSimplifiedMonosArray(res_size, res_arr);
+}
 
-            if (PolyIsZero(&tmp_poly)) tmp_exp = 0;
+/**
+ * Długość wektorów współczynników, od której są one mnożone algorytmem
+ * Karacuby zamiast algorytmu szkolnego.
+ */
+#define KARATSUBA_THRESHOLD 24
 
-            new_arr[k++] = MonoFromPoly(&tmp_poly, tmp_exp);
+/**
+ * Mnoży wektory współczynników algorytmem szkolnym. Obliczenia są
+ * wykonywane modulo @f$2^{64}@f$, tak jak na współczynnikach wielomianów.
+ * @param[in] a : wektor @f$a@f$
+ * @param[in] na : długość wektora @f$a@f$
+ * @param[in] b : wektor @f$b@f$
+ * @param[in] nb : długość wektora @f$b@f$
+ * @param[out] res : wektor długości `na + nb - 1`, do którego zapisywany
+ * jest iloczyn
+ */
+static void DenseMulSchoolbook(const uint64_t *a, size_t na,
+                               const uint64_t *b, size_t nb, uint64_t *res) {
+    memset(res, 0, (na + nb - 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < na; i++) {
+        if (a[i] == 0) continue;
+        for (size_t j = 0; j < nb; j++) {
+            res[i + j] += a[i] * b[j];
         }
     }
+}
+
+/**
+ * Mnoży wektory współczynników tej samej długości algorytmem Karacuby.
+ * Dla @f$a = a_0 + x^m a_1@f$ i @f$b = b_0 + x^m b_1@f$ iloczyn jest liczony
+ * z trzech iloczynów: @f$a_0 b_0@f$, @f$a_1 b_1@f$ oraz
+ * @f$(a_0 + a_1)(b_0 + b_1)@f$.
+ * @param[in] a : wektor @f$a@f$
+ * @param[in] b : wektor @f$b@f$
+ * @param[in] n : długość wektorów
+ * @param[out] res : wektor długości `2n - 1`, do którego zapisywany jest
+ * iloczyn
+ */
+static void DenseMulKaratsuba(const uint64_t *a, const uint64_t *b, size_t n,
+                              uint64_t *res) {
+    if (n < KARATSUBA_THRESHOLD) {
+        DenseMulSchoolbook(a, n, b, n, res);
+        return;
+    }
+
+    size_t m = n / 2;
+    size_t h = n - m;
+
+    // a_0 b_0 zajmuje res[0..2m-2], a_1 b_1 zajmuje res[2m..2n-2]
+    DenseMulKaratsuba(a, b, m, res);
+    res[2 * m - 1] = 0;
+    DenseMulKaratsuba(a + m, b + m, h, res + 2 * m);
+
+    uint64_t *tmp = (uint64_t*) malloc((4 * h - 1) * sizeof(uint64_t));
+    CheckPtr(tmp);
+    uint64_t *sa = tmp;
+    uint64_t *sb = tmp + h;
+    uint64_t *mid = tmp + 2 * h;
+
+    for (size_t i = 0; i < h; i++) {
+        sa[i] = a[m + i] + (i < m ? a[i] : 0);
+        sb[i] = b[m + i] + (i < m ? b[i] : 0);
+    }
+    DenseMulKaratsuba(sa, sb, h, mid);
+
+    for (size_t i = 0; i < 2 * m - 1; i++) {
+        mid[i] -= res[i];
+    }
+    for (size_t i = 0; i < 2 * h - 1; i++) {
+        mid[i] -= res[2 * m + i];
+    }
+    for (size_t i = 0; i < 2 * h - 1; i++) {
+        res[m + i] += mid[i];
+    }
+
+    free(tmp);
+}
+
+#if defined(__SIZEOF_INT128__)
+/** Czy kompilowane jest mnożenie wektorów współczynników za pomocą NTT. */
+#define POLY_NTT
+
+/**
+ * Długość krótszego wektora współczynników, od której są one mnożone za
+ * pomocą NTT zamiast algorytmu Karacuby.
+ */
+#define NTT_THRESHOLD 16384
+
+/** Liczba liczb pierwszych, modulo które liczony jest splot. */
+#define NTT_PRIMES 3
+
+/**
+ * Liczby pierwsze postaci @f$c 2^{40} + 1@f$ z przedziału
+ * @f$[2^{61}, 2^{62})@f$ i generatory ich grup multiplikatywnych. Iloczyn
+ * liczb jest większy niż @f$2^{183}@f$, więc wyznaczają one jednoznacznie
+ * współczynniki splotu wektorów liczb mniejszych niż @f$2^{64}@f$ o długości
+ * mniejszej niż @f$2^{55}@f$.
+ */
+static const uint64_t ntt_primes[NTT_PRIMES][2] = {
+    {UINT64_C(4611615649683210241), 11},
+    {UINT64_C(4611613450659954689), 3},
+    {UINT64_C(4611549678985543681), 19},
+};
+
+/**
+ * Liczba pierwsza używana w NTT wraz ze stałymi potrzebnymi do mnożenia
+ * Montgomery'ego modulo ta liczba (z @f$R = 2^{64}@f$).
+ */
+typedef struct NttPrime {
+    uint64_t p;         ///< liczba pierwsza @f$p < 2^{62}@f$
+    uint64_t g;         ///< generator grupy multiplikatywnej modulo @f$p@f$
+    uint64_t neg_inv;   ///< @f$-p^{-1} \bmod 2^{64}@f$
+    uint64_t r2;        ///< @f$R^2 \bmod p@f$
+} NttPrime;
 
-    Poly res = PolyAddMonos(p->size * q->size, new_arr);
-    free(new_arr);
+/**
+ * Mnoży liczby metodą Montgomery'ego.
+ * @param[in] m : liczba pierwsza @f$p@f$
+ * @param[in] a : liczba @f$a < p@f$
+ * @param[in] b : liczba @f$b < p@f$
+ * @return @f$a b R^{-1} \bmod p@f$
+ */
+static inline uint64_t MontMul(const NttPrime *m, uint64_t a, uint64_t b) {
+    unsigned __int128 t = (unsigned __int128) a * b;
+    uint64_t q = (uint64_t) t * m->neg_inv;
+    uint64_t res = (uint64_t) ((t + (unsigned __int128) q * m->p) >> 64);
+    return res >= m->p ? res - m->p : res;
+}
+
+/**
+ * Dodaje liczby modulo @f$p@f$.
+ * @param[in] a : liczba @f$a < p@f$
+ * @param[in] b : liczba @f$b < p@f$
+ * @param[in] p : moduł @f$p < 2^{63}@f$
+ * @return @f$a + b \bmod p@f$
+ */
+static inline uint64_t ModAdd(uint64_t a, uint64_t b, uint64_t p) {
+    uint64_t s = a + b;
+    return s >= p ? s - p : s;
+}
+
+/**
+ * Redukuje liczbę modulo jedna z liczb pierwszych `ntt_primes`. Liczby te
+ * różnią się od @f$2^{62}@f$ o mniej niż @f$2^{47}@f$, więc po odjęciu
+ * @f$\lfloor x / 2^{62} \rfloor p@f$ wystarcza jedno odejmowanie, a nie
+ * jest potrzebne dzielenie.
+ * @param[in] x : liczba
+ * @param[in] p : liczba pierwsza z tablicy `ntt_primes`
+ * @return @f$x \bmod p@f$
+ */
+static inline uint64_t NttReduce(uint64_t x, uint64_t p) {
+    x -= (x >> 62) * p;
+    return x >= p ? x - p : x;
+}
+
+/**
+ * Odejmuje liczby modulo @f$p@f$.
+ * @param[in] a : liczba @f$a < p@f$
+ * @param[in] b : liczba @f$b < p@f$
+ * @param[in] p : moduł @f$p@f$
+ * @return @f$a - b \bmod p@f$
+ */
+static inline uint64_t ModSub(uint64_t a, uint64_t b, uint64_t p) {
+    return a >= b ? a - b : a + p - b;
+}
 
+/**
+ * Zamienia liczbę na postać Montgomery'ego.
+ * @param[in] m : liczba pierwsza @f$p@f$
+ * @param[in] a : liczba @f$a < p@f$
+ * @return @f$a R \bmod p@f$
+ */
+static inline uint64_t ToMont(const NttPrime *m, uint64_t a) {
+    return MontMul(m, a, m->r2);
+}
+
+/**
+ * Podnosi liczbę w postaci Montgomery'ego do potęgi.
+ * @param[in] m : liczba pierwsza @f$p@f$
+ * @param[in] base : podstawa w postaci Montgomery'ego
+ * @param[in] exp : wykładnik
+ * @return potęga w postaci Montgomery'ego
+ */
+static uint64_t MontPow(const NttPrime *m, uint64_t base, uint64_t exp) {
+    uint64_t res = ToMont(m, 1);
+    while (exp > 0) {
+        if (exp & 1) res = MontMul(m, res, base);
+        base = MontMul(m, base, base);
+        exp >>= 1;
+    }
     return res;
 }
 
+/**
+ * Wyznacza stałe mnożenia Montgomery'ego modulo liczba pierwsza.
+ * @param[out] m : liczba pierwsza i jej stałe
+ * @param[in] p : liczba pierwsza
+ * @param[in] g : generator grupy multiplikatywnej modulo @p p
+ */
+static void NttPrimeInit(NttPrime *m, uint64_t p, uint64_t g) {
+    m->p = p;
+    m->g = g;
+
+    // odwrotność modulo 2^64 metodą Newtona - każdy krok podwaja liczbę
+    // poprawnych bitów
+    uint64_t inv = p;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - p * inv;
+    }
+    m->neg_inv = -inv;
+
+    uint64_t r = -p % p;
+    m->r2 = (uint64_t) ((unsigned __int128) r * r % p);
+}
+
+/**
+ * Wyznacza potęgi pierwiastków z jedności używane w NTT rozmiaru @p n .
+ * Dla każdego @f$len < n@f$ będącego potęgą dwójki `tw[len + j]` jest
+ * @f$j@f$-tą potęgą pierwiastka pierwotnego stopnia @f$2 len@f$
+ * (w postaci Montgomery'ego), więc czynniki jednej warstwy NTT leżą obok
+ * siebie w pamięci.
+ * @param[in] m : liczba pierwsza
+ * @param[in] n : rozmiar NTT, potęga dwójki
+ * @param[in] inverse : czy wyznaczyć odwrotności pierwiastków?
+ * @param[out] tw : tablica @p n potęg
+ */
+static void NttTwiddles(const NttPrime *m, size_t n, bool inverse,
+                        uint64_t *tw) {
+    uint64_t g = ToMont(m, m->g);
+    for (size_t len = 1; len < n; len *= 2) {
+        uint64_t exp = (m->p - 1) / (2 * len);
+        uint64_t step = MontPow(m, g, inverse ? m->p - 1 - exp : exp);
+        tw[len] = ToMont(m, 1);
+        for (size_t j = 1; j < len; j++) {
+            tw[len + j] = MontMul(m, tw[len + j - 1], step);
+        }
+    }
+}
+
+/**
+ * Wykonuje NTT w miejscu, z decymacją w częstotliwości. Wynik jest
+ * w kolejności odwróconych bitów indeksów.
+ * @param[in] m : liczba pierwsza
+ * @param[in,out] a : wektor @p n liczb mniejszych niż @f$p@f$
+ * @param[in] n : rozmiar NTT, potęga dwójki
+ * @param[in] tw : potęgi pierwiastków z jedności
+ */
+static void NttForward(const NttPrime *m, uint64_t *a, size_t n,
+                       const uint64_t *tw) {
+    uint64_t p = m->p;
+    for (size_t len = n / 2; len >= 1; len /= 2) {
+        for (size_t start = 0; start < n; start += 2 * len) {
+            uint64_t *lo = a + start;
+            uint64_t *hi = a + start + len;
+            for (size_t j = 0; j < len; j++) {
+                uint64_t u = lo[j], v = hi[j];
+                lo[j] = ModAdd(u, v, p);
+                hi[j] = MontMul(m, ModSub(u, v, p), tw[len + j]);
+            }
+        }
+    }
+}
+
+/**
+ * Wykonuje odwrotne NTT w miejscu, z decymacją w czasie, na wektorze
+ * w kolejności odwróconych bitów indeksów. Wynik nie jest dzielony
+ * przez @p n .
+ * @param[in] m : liczba pierwsza
+ * @param[in,out] a : wektor @p n liczb mniejszych niż @f$p@f$
+ * @param[in] n : rozmiar NTT, potęga dwójki
+ * @param[in] tw : odwrotności potęg pierwiastków z jedności
+ */
+static void NttInverse(const NttPrime *m, uint64_t *a, size_t n,
+                       const uint64_t *tw) {
+    uint64_t p = m->p;
+    for (size_t len = 1; len < n; len *= 2) {
+        for (size_t start = 0; start < n; start += 2 * len) {
+            uint64_t *lo = a + start;
+            uint64_t *hi = a + start + len;
+            for (size_t j = 0; j < len; j++) {
+                uint64_t u = lo[j];
+                uint64_t v = MontMul(m, hi[j], tw[len + j]);
+                lo[j] = ModAdd(u, v, p);
+                hi[j] = ModSub(u, v, p);
+            }
+        }
+    }
+}
+
+/**
+ * Liczy splot wektorów modulo liczba pierwsza za pomocą NTT.
+ * @param[in] m : liczba pierwsza
+ * @param[in] a : wektor @f$a@f$
+ * @param[in] na : długość wektora @f$a@f$
+ * @param[in] b : wektor @f$b@f$
+ * @param[in] nb : długość wektora @f$b@f$
+ * @param[in] n : rozmiar NTT, potęga dwójki nie mniejsza niż `na + nb - 1`
+ * @param[in] fa : bufor na @p n liczb
+ * @param[in] fb : bufor na @p n liczb
+ * @param[in] tw : bufor na @p n liczb
+ * @param[out] res : wektor długości `na + nb - 1`, do którego zapisywany
+ * jest splot modulo @f$p@f$
+ */
+static void NttConvolve(const NttPrime *m, const uint64_t *a, size_t na,
+                        const uint64_t *b, size_t nb, size_t n,
+                        uint64_t *fa, uint64_t *fb, uint64_t *tw,
+                        uint64_t *res) {
+    for (size_t i = 0; i < n; i++) {
+        fa[i] = i < na ? NttReduce(a[i], m->p) : 0;
+        fb[i] = i < nb ? NttReduce(b[i], m->p) : 0;
+    }
+
+    NttTwiddles(m, n, false, tw);
+    NttForward(m, fa, n, tw);
+    NttForward(m, fb, n, tw);
+
+    // iloczyn Montgomery'ego dodaje czynnik R^{-1}, który razem z dzieleniem
+    // przez n jest usuwany na końcu mnożeniem przez n^{-1} R^2
+    for (size_t i = 0; i < n; i++) {
+        fa[i] = MontMul(m, fa[i], fb[i]);
+    }
+
+    NttTwiddles(m, n, true, tw);
+    NttInverse(m, fa, n, tw);
+
+    uint64_t n_inv = MontPow(m, ToMont(m, n % m->p), m->p - 2);
+    uint64_t scale = MontMul(m, n_inv, m->r2);
+    for (size_t i = 0; i < na + nb - 1; i++) {
+        res[i] = MontMul(m, fa[i], scale);
+    }
+}
+
+/**
+ * Mnoży wektory współczynników za pomocą NTT modulo `NTT_PRIMES` liczb
+ * pierwszych. Współczynniki iloczynu są odtwarzane z reszt algorytmem
+ * Garnera, a następnie redukowane modulo @f$2^{64}@f$.
+ * @param[in] a : wektor @f$a@f$
+ * @param[in] na : długość wektora @f$a@f$
+ * @param[in] b : wektor @f$b@f$
+ * @param[in] nb : długość wektora @f$b@f$
+ * @param[out] res : wektor długości `na + nb - 1`, do którego zapisywany
+ * jest iloczyn
+ */
+static void DenseMulNtt(const uint64_t *a, size_t na,
+                        const uint64_t *b, size_t nb, uint64_t *res) {
+    size_t res_len = na + nb - 1;
+    size_t n = 1;
+    while (n < res_len) n *= 2;
+
+    uint64_t *buf = (uint64_t*) malloc((3 * n + NTT_PRIMES * res_len) *
+                                       sizeof(uint64_t));
+    CheckPtr(buf);
+    uint64_t *fa = buf, *fb = buf + n, *tw = buf + 2 * n;
+    uint64_t *rem[NTT_PRIMES];
+
+    NttPrime m[NTT_PRIMES];
+    for (size_t k = 0; k < NTT_PRIMES; k++) {
+        NttPrimeInit(&m[k], ntt_primes[k][0], ntt_primes[k][1]);
+        rem[k] = buf + 3 * n + k * res_len;
+        NttConvolve(&m[k], a, na, b, nb, n, fa, fb, tw, rem[k]);
+    }
+
+    // algorytm Garnera: c = x_0 + x_1 p_0 + x_2 p_0 p_1, gdzie x_k < p_k
+    uint64_t p0 = m[0].p, p1 = m[1].p, p2 = m[2].p;
+    // stałe są w postaci Montgomery'ego, więc mnożenie przez nie metodą
+    // Montgomery'ego daje wynik w zwykłej postaci
+    uint64_t inv_p0_mod_p1 =
+        MontPow(&m[1], ToMont(&m[1], NttReduce(p0, p1)), p1 - 2);
+    uint64_t p0_mod_p2 = ToMont(&m[2], NttReduce(p0, p2));
+    uint64_t inv_p0p1_mod_p2 = MontPow(
+            &m[2], MontMul(&m[2], p0_mod_p2, ToMont(&m[2], NttReduce(p1, p2))),
+            p2 - 2);
+
+    for (size_t i = 0; i < res_len; i++) {
+        uint64_t x0 = rem[0][i];
+        uint64_t x1 = MontMul(&m[1], ModSub(rem[1][i], NttReduce(x0, p1), p1),
+                              inv_p0_mod_p1);
+        uint64_t t = ModSub(rem[2][i], NttReduce(x0, p2), p2);
+        t = ModSub(t, MontMul(&m[2], NttReduce(x1, p2), p0_mod_p2), p2);
+        uint64_t x2 = MontMul(&m[2], t, inv_p0p1_mod_p2);
+        res[i] = x0 + x1 * p0 + x2 * p0 * p1;
+    }
+
+    free(buf);
+}
+#endif /* __SIZEOF_INT128__ */
+
+/**
+ * Mnoży wektory współczynników, dzieląc dłuższy z nich na bloki o długości
+ * krótszego i mnożąc je algorytmem Karacuby. Długie wektory są mnożone
+ * za pomocą NTT, jeśli jest ono dostępne.
+ * @param[in] a : wektor @f$a@f$
+ * @param[in] na : długość wektora @f$a@f$
+ * @param[in] b : wektor @f$b@f$
+ * @param[in] nb : długość wektora @f$b@f$
+ * @param[out] res : wektor długości `na + nb - 1`, do którego zapisywany
+ * jest iloczyn
+ */
+static void DenseMul(const uint64_t *a, size_t na,
+                     const uint64_t *b, size_t nb, uint64_t *res) {
+    if (na > nb) {
+        DenseMul(b, nb, a, na, res);
+        return;
+    }
+
+    if (na < KARATSUBA_THRESHOLD) {
+        DenseMulSchoolbook(a, na, b, nb, res);
+        return;
+    }
+
+#ifdef POLY_NTT
+    if (na >= NTT_THRESHOLD) {
+        DenseMulNtt(a, na, b, nb, res);
+        return;
+    }
+#endif
+
+    memset(res, 0, (na + nb - 1) * sizeof(uint64_t));
+    uint64_t *block = (uint64_t*) malloc((2 * na - 1) * sizeof(uint64_t));
+    CheckPtr(block);
+
+    for (size_t start = 0; start < nb; start += na) {
+        size_t len = nb - start < na ? nb - start : na;
+        if (len == na) {
+            DenseMulKaratsuba(a, b + start, na, block);
+        } else {
+            DenseMul(a, na, b + start, len, block);
+        }
+        for (size_t i = 0; i < na + len - 1; i++) {
+            res[start + i] += block[i];
+        }
+    }
+
+    free(block);
+}
+
+/**
+ * Zapisuje współczynniki wielomianu jednej zmiennej o stałych
+ * współczynnikach do wektora indeksowanego wykładnikami pomniejszonymi
+ * o najmniejszy wykładnik.
+ * @param[in] p : wielomian niebędący stałą, o stałych współczynnikach
+ * @param[out] len : długość wektora
+ * @return wektor współczynników, który należy zwolnić funkcją `free`
+ */
+static uint64_t *DenseFromPoly(const Poly *p, size_t *len) {
+    poly_exp_t min_exp = MonoGetExp(&p->arr[p->size-1]);
+    *len = (size_t) (MonoGetExp(&p->arr[0]) - min_exp) + 1;
+
+    uint64_t *vec = (uint64_t*) calloc(*len, sizeof(uint64_t));
+    CheckPtr(vec);
+    for (size_t i = 0; i < p->size; i++) {
+        vec[MonoGetExp(&p->arr[i]) - min_exp] = (uint64_t) p->arr[i].p.coeff;
+    }
+    return vec;
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące stałymi, o stałych współczynnikach,
+ * zamieniając je na wektory współczynników. Iloczyn jest zamieniany
+ * z powrotem na tablicę jednomianów dopiero na końcu.
+ *
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulDense(const Poly *p, const Poly *q) {
+    size_t p_len, q_len;
+    uint64_t *p_vec = DenseFromPoly(p, &p_len);
+    uint64_t *q_vec = DenseFromPoly(q, &q_len);
+    size_t res_len = p_len + q_len - 1;
+    uint64_t *res_vec = (uint64_t*) malloc(res_len * sizeof(uint64_t));
+    CheckPtr(res_vec);
+
+    DenseMul(p_vec, p_len, q_vec, q_len, res_vec);
+    free(p_vec);
+    free(q_vec);
+
+    poly_exp_t min_exp = MonoGetExp(&p->arr[p->size-1]) +
+                         MonoGetExp(&q->arr[q->size-1]);
+    size_t count = 0;
+    for (size_t i = 0; i < res_len; i++) {
+        if (res_vec[i] != 0) count++;
+    }
+
+    Mono *res_arr = MonoArrayAlloc(count);
+    size_t k = 0;
+    for (size_t i = res_len; i-- > 0;) {
+        if (res_vec[i] != 0) {
+            res_arr[k++] = (Mono) {
+                .p = PolyFromCoeff((poly_coeff_t) res_vec[i]),
+                .exp = min_exp + (poly_exp_t) i
+            };
+        }
+    }
+    free(res_vec);
+
+    return PolyFromSimplifiedMonosArray(count, res_arr);
+}
+
+/**
+ * Wyznacza liczbę zmiennych wielomianu (głębokość jego struktury) i liczbę
+ * jego wyrazów po rozwinięciu do sumy jednomianów wszystkich zmiennych.
+ * @param[in] p : wielomian różny od zera
+ * @param[out] terms : liczba wyrazów
+ * @return liczba zmiennych
+ */
+static size_t PolyDepth(const Poly *p, size_t *terms) {
+    if (PolyIsCoeff(p)) {
+        (*terms)++;
+        return 0;
+    }
+
+    size_t depth = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        size_t d = PolyDepth(&p->arr[i].p, terms);
+        if (d > depth) depth = d;
+    }
+    return depth + 1;
+}
+
+/**
+ * Wyznacza stopnie wielomianu ze względu na kolejne zmienne, tak jak funkcja
+ * `PolyDegBy`, korzystając z zapamiętanych stopni lub w jednym przejściu po
+ * wielomianie.
+ * @param[in] p : wielomian
+ * @param[in] var : indeks zmiennej wielomianu @p p
+ * @param[in,out] degs : stopnie ze względu na zmienne o indeksach nie
+ * mniejszych niż @p var , zwiększane do stopni wielomianu @p p
+ */
+static void PolyVarDegs(const Poly *p, size_t var, poly_exp_t degs[]) {
+    if (PolyIsCoeff(p)) return;
+
+    size_t nvars = MonoArrayGetHeader(p->arr)->nvars;
+    if (nvars <= MAX_CACHED_VAR_DEGS) {
+        for (size_t i = 0; i < nvars; i++) {
+            if (PolyDegBy(p, i) > degs[var + i]) {
+                degs[var + i] = PolyDegBy(p, i);
+            }
+        }
+        return;
+    }
+
+    if (MonoGetExp(&p->arr[0]) > degs[var]) {
+        degs[var] = MonoGetExp(&p->arr[0]);
+    }
+    for (size_t i = 0; i < p->size; i++) {
+        PolyVarDegs(&p->arr[i].p, var + 1, degs);
+    }
+}
+
+/**
+ * Zamienia wielomian wielu zmiennych na tablicę jednomianów jednej zmiennej
+ * przez podstawienie @f$x_i \to x^{s_i}@f$. Jednomiany są dopisywane
+ * malejąco względem wykładnika, bo @f$s_0 > s_1 > \ldots@f$.
+ * @param[in] p : wielomian
+ * @param[in] var : indeks zmiennej wielomianu @p p
+ * @param[in] strides : wykładniki @f$s_i@f$
+ * @param[in] exp : wykładnik wynikający ze zmiennych o mniejszych indeksach
+ * @param[in,out] arr : tablica jednomianów
+ * @param[in,out] size : liczba jednomianów w tablicy
+ */
+static void KroneckerPack(const Poly *p, size_t var, const size_t strides[],
+                          size_t exp, Mono *arr, size_t *size) {
+    if (PolyIsCoeff(p)) {
+        arr[(*size)++] = (Mono) {.p = *p, .exp = (poly_exp_t) exp};
+        return;
+    }
+
+    for (size_t i = 0; i < p->size; i++) {
+        KroneckerPack(&p->arr[i].p, var + 1, strides,
+                      exp + (size_t) MonoGetExp(&p->arr[i]) * strides[var],
+                      arr, size);
+    }
+}
+
+/**
+ * Odtwarza wielomian wielu zmiennych z fragmentu posortowanej malejąco
+ * tablicy jednomianów jednej zmiennej, w którym wszystkie jednomiany mają
+ * te same wykładniki zmiennych o indeksach mniejszych niż @p var .
+ * @param[in] arr : tablica jednomianów o stałych współczynnikach
+ * @param[in] lo : indeks pierwszego jednomianu fragmentu
+ * @param[in] hi : indeks za ostatnim jednomianem fragmentu
+ * @param[in] var : indeks zmiennej tworzonego wielomianu
+ * @param[in] nvars : liczba zmiennych
+ * @param[in] strides : wykładniki @f$s_i@f$ użyte w podstawieniu
+ * @param[in] bounds : ograniczenia @f$D_i@f$ wykładników zmiennych
+ * @return wielomian złożony z jednomianów fragmentu
+ */
+static Poly KroneckerUnpack(const Mono *arr, size_t lo, size_t hi,
+                            size_t var, size_t nvars, const size_t strides[],
+                            const size_t bounds[]) {
+    if (var == nvars) {
+        return arr[lo].p;
+    }
+
+    Mono *monos = MonoArrayAlloc(hi - lo);
+    size_t count = 0;
+    size_t i = lo;
+    while (i < hi) {
+        size_t exp = (size_t) MonoGetExp(&arr[i]) / strides[var] % bounds[var];
+        size_t j = i + 1;
+        while (j < hi && (size_t) MonoGetExp(&arr[j]) / strides[var] %
+                         bounds[var] == exp) {
+            j++;
+        }
+        monos[count++] = (Mono) {
+            .p = KroneckerUnpack(arr, i, j, var + 1, nvars, strides, bounds),
+            .exp = (poly_exp_t) exp
+        };
+        i = j;
+    }
+
+    return PolyFromSimplifiedMonosArray(count, monos);
+}
+
+/**
+ * Mnoży dwa wielomiany niebędące stałymi za pomocą podstawienia Kroneckera.
+ * Jeśli @f$D_i@f$ jest większe od sumy stopni czynników ze względu na
+ * zmienną @f$x_i@f$, to podstawienie @f$x_i \to x^{s_i}@f$, gdzie
+ * @f$s_i = D_{i+1} \cdots D_{n-1}@f$, jest różnowartościowe na jednomianach
+ * iloczynu. Czynniki są więc mnożone jako wielomiany jednej zmiennej
+ * o stałych współczynnikach, a wynik jest rozkładany z powrotem.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[out] res : @f$p * q@f$
+ * @return czy iloczyn został obliczony? Podstawienie nie jest stosowane,
+ * jeśli wykładniki nie mieszczą się w typie `poly_exp_t` lub jeśli
+ * iloczynów wyrazów jest mniej niż dwa razy więcej niż możliwych
+ * wykładników.
+ */
+static bool PolyMulKronecker(const Poly *p, const Poly *q, Poly *res) {
+    // liczba zmiennych i stopnie są zapamiętane w nagłówkach tablic, więc
+    // większość par czynników jest odrzucana bez przechodzenia po nich
+    size_t p_nvars = MonoArrayGetHeader(p->arr)->nvars;
+    size_t q_nvars = MonoArrayGetHeader(q->arr)->nvars;
+    size_t nvars = p_nvars > q_nvars ? p_nvars : q_nvars;
+
+    poly_exp_t local_degs[2 * MAX_CACHED_VAR_DEGS] = {0};
+    size_t local_strides[2 * MAX_CACHED_VAR_DEGS];
+    bool local = nvars <= MAX_CACHED_VAR_DEGS;
+    poly_exp_t *p_degs = local ? local_degs :
+        (poly_exp_t*) calloc(2 * nvars, sizeof(poly_exp_t));
+    size_t *strides = local ? local_strides :
+        (size_t*) calloc(2 * nvars, sizeof(size_t));
+    CheckPtr(p_degs);
+    CheckPtr(strides);
+    poly_exp_t *q_degs = p_degs + nvars;
+    size_t *bounds = strides + nvars;
+    PolyVarDegs(p, 0, p_degs);
+    PolyVarDegs(q, 0, q_degs);
+
+    // liczba wyrazów wielomianu nie przekracza iloczynu stopni zwiększonych
+    // o jeden, co ogranicza liczbę iloczynów wyrazów bez ich zliczania
+    bool fits = true;
+    size_t stride = 1, max_products = 1;
+    for (size_t i = nvars; i-- > 0;) {
+        bounds[i] = (size_t) p_degs[i] + (size_t) q_degs[i] + 1;
+        strides[i] = stride;
+        if (bounds[i] > (size_t) INT_MAX / stride) {
+            fits = false;
+            break;
+        }
+        stride *= bounds[i];
+
+        size_t factor = ((size_t) p_degs[i] + 1) * ((size_t) q_degs[i] + 1);
+        max_products = max_products > SIZE_MAX / factor ?
+            SIZE_MAX : max_products * factor;
+    }
+    if (!local) free(p_degs);
+
+    // podstawienie opłaca się tylko wtedy, gdy wiele iloczynów wyrazów ma
+    // ten sam wykładnik - w przeciwnym przypadku mnożenie rekurencyjne
+    // korzysta z mniejszych kopców
+    size_t p_terms = 0, q_terms = 0;
+    if (fits && 2 * stride <= max_products) {
+        PolyDepth(p, &p_terms);
+        PolyDepth(q, &q_terms);
+    }
+    if (!fits || 2 * stride > p_terms * q_terms) {
+        if (!local) free(strides);
+        return false;
+    }
+
+    Mono *p_arr = MonoArrayAlloc(p_terms);
+    Mono *q_arr = MonoArrayAlloc(q_terms);
+    size_t p_size = 0, q_size = 0;
+    KroneckerPack(p, 0, strides, 0, p_arr, &p_size);
+    KroneckerPack(q, 0, strides, 0, q_arr, &q_size);
+    Poly p_uni = PolyFromSimplifiedMonosArray(p_size, p_arr);
+    Poly q_uni = PolyFromSimplifiedMonosArray(q_size, q_arr);
+
+    Poly prod = PolyMul(&p_uni, &q_uni);
+    PolyDestroy(&p_uni);
+    PolyDestroy(&q_uni);
+
+    if (PolyIsCoeff(&prod)) {
+        *res = prod;
+    } else {
+        *res = KroneckerUnpack(prod.arr, 0, prod.size, 0, nvars, strides,
+                               bounds);
+        MonoArrayFree(prod.arr);
+    }
+
+    if (!local) free(strides);
+    return true;
+}
+
+/**
+ * Najmniejsza liczba jednomianów krótszego czynnika, przy której opłaca się
+ * mnożenie z użyciem tablicy haszującej lub wektorów współczynników.
+ */
+#define MUL_HASH_MIN_SIZE 16
+
+/**
+ * Najmniejsza liczba iloczynów wyrazów czynników (po rozwinięciu do sum
+ * jednomianów wszystkich zmiennych), przy której mnożenie jest rozdzielane
+ * na wątki. Dla mniejszych czynników koszt uruchomienia wątków przeważa.
+ */
+#define PARALLEL_MUL_MIN_PRODUCTS ((size_t) 1 << 16)
+
+/**
+ * Struktura opisująca równoległe sumowanie wielomianów.
+ */
+typedef struct ParallelSum {
+    Poly *parts; ///< sumowane wielomiany, zastępowane sumami częściowymi
+    size_t step; ///< odległość dodawanych wielomianów w drzewie sumowania
+} ParallelSum;
+
+/**
+ * Dodaje do siebie dwie sumy częściowe w jednym poziomie drzewa sumowania.
+ * @param[in] arg : opis sumowania (`ParallelSum`)
+ * @param[in] i : indeks pary sum w poziomie
+ */
+static void ParallelSumTask(void *arg, size_t i) {
+    ParallelSum *sum = (ParallelSum*) arg;
+    size_t j = 2 * i * sum->step;
+    PolyAddAssign(&sum->parts[j], &sum->parts[j + sum->step]);
+}
+
+/**
+ * Sumuje wielomiany na wielu wątkach, dodając je parami w drzewie
+ * o wysokości logarytmicznej względem ich liczby. Przejmuje wielomiany na
+ * własność.
+ * @param[in] count : liczba wielomianów, dodatnia
+ * @param[in] parts : wielomiany
+ * @return suma wielomianów
+ */
+static Poly PolySumParallel(size_t count, Poly parts[]) {
+    ParallelSum sum = {.parts = parts, .step = 1};
+    for (; sum.step < count; sum.step *= 2) {
+        PolyParallelFor((count + sum.step - 1) / (2 * sum.step),
+                        ParallelSumTask, &sum);
+    }
+    return parts[0];
+}
+
+/**
+ * Struktura opisująca zadania równoległego mnożenia wielomianów.
+ */
+typedef struct ParallelMul {
+    const Poly *p; ///< czynnik mnożony przez każdy fragment drugiego czynnika
+    Poly *parts;   ///< fragmenty drugiego czynnika, zastępowane iloczynami
+} ParallelMul;
+
+/**
+ * Mnoży fragment drugiego czynnika przez pierwszy czynnik.
+ * @param[in] arg : opis mnożenia (`ParallelMul`)
+ * @param[in] i : indeks fragmentu
+ */
+static void ParallelMulTask(void *arg, size_t i) {
+    ParallelMul *mul = (ParallelMul*) arg;
+    Poly prod = PolyMul(mul->p, &mul->parts[i]);
+    PolyDestroy(&mul->parts[i]);
+    mul->parts[i] = prod;
+}
+
+/**
+ * Mnoży wielomiany na wielu wątkach, jeśli się to opłaca. Dzieli dłuższy
+ * czynnik na spójne fragmenty o zbliżonej liczbie wyrazów, mnoży każdy
+ * fragment przez krótszy czynnik sekwencyjnie, a iloczyny częściowe dodaje
+ * parami, w drzewie o wysokości logarytmicznej względem liczby wątków.
+ * @param[in] p : krótszy wielomian @f$p@f$, który nie jest stały
+ * @param[in] q : dłuższy wielomian @f$q@f$, który nie jest stały
+ * @param[out] res : @f$p * q@f$, jeśli mnożenie zostało wykonane
+ * @return czy mnożenie zostało wykonane?
+ */
+static bool PolyMulParallel(const Poly *p, const Poly *q, Poly *res) {
+    size_t threads = PolyGetThreads();
+    if (threads <= 1 || q->size < 2 || PolyInParallel()) {
+        return false;
+    }
+
+    size_t p_terms = 0;
+    PolyDepth(p, &p_terms);
+    size_t *terms = (size_t*) malloc(q->size * sizeof(size_t));
+    CheckPtr(terms);
+    size_t q_terms = 0;
+    for (size_t i = 0; i < q->size; i++) {
+        terms[i] = 0;
+        PolyDepth(&q->arr[i].p, &terms[i]);
+        q_terms += terms[i];
+    }
+
+    if (p_terms < (PARALLEL_MUL_MIN_PRODUCTS + q_terms - 1) / q_terms) {
+        free(terms);
+        return false;
+    }
+
+    size_t count = threads < q->size ? threads : q->size;
+    Poly *parts = (Poly*) malloc(count * sizeof(Poly));
+    CheckPtr(parts);
+
+    // fragment kończy się, gdy ma swoją część wyrazów lub gdy zostało już
+    // tylko tyle jednomianów, ile brakuje fragmentów
+    size_t n = 0, begin = 0, sum = 0;
+    for (size_t i = 0; i < q->size; i++) {
+        sum += terms[i];
+        if (sum * count >= (n + 1) * q_terms ||
+            q->size - i - 1 == count - n - 1)
+        {
+            Mono *arr = CloneMonoArray(i + 1 - begin, q->arr + begin);
+            parts[n++] = PolyFromSimplifiedMonosArray(i + 1 - begin, arr);
+            begin = i + 1;
+        }
+    }
+    assert(n == count && begin == q->size);
+    free(terms);
+
+    ParallelMul mul = {.p = p, .parts = parts};
+    PolyParallelFor(count, ParallelMulTask, &mul);
+    *res = PolySumParallel(count, parts);
+    free(parts);
+    return true;
+}
+
+Poly PolyMul(const Poly *p, const Poly *q) {
+    if (PolyIsCoeff(p)) return PolyMulByCoeff(q, p->coeff);
+    if (PolyIsCoeff(q)) return PolyMulByCoeff(p, q->coeff);
+
+    if (p->size > q->size) {
+        const Poly *tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    Poly res;
+    if (PolyMulParallel(p, q, &res)) {
+        return res;
+    }
+
+    // zamiast rekurencyjnego mnożenia współczynników wielomiany wielu
+    // zmiennych są mnożone jako wielomiany jednej zmiennej
+    bool coeffs_only = MonoArrayHasCoeffsOnly(p->arr, p->size) &&
+                       MonoArrayHasCoeffsOnly(q->arr, q->size);
+    if (!coeffs_only && PolyMulKronecker(p, q, &res)) {
+        return res;
+    }
+
+    // iloczyny jednomianów mają wykładniki z przedziału o długości `range`,
+    // więc jeśli iloczynów jest dużo więcej, to wiele z nich się sumuje
+    // i zamiast kopca lepiej użyć tablicy haszującej
+    size_t products = p->size * q->size;
+    size_t p_span =
+        (size_t) (MonoGetExp(&p->arr[0]) - MonoGetExp(&p->arr[p->size-1])) + 1;
+    size_t q_span =
+        (size_t) (MonoGetExp(&q->arr[0]) - MonoGetExp(&q->arr[q->size-1])) + 1;
+    size_t range = p_span + q_span - 1;
+
+    if (p->size >= MUL_HASH_MIN_SIZE && 2 * range <= products) {
+        // jeśli czynniki wypełniają co najmniej połowę swoich przedziałów
+        // wykładników i mają stałe współczynniki, to są mnożone jako wektory
+        if (2 * p->size >= p_span && 2 * q->size >= q_span && coeffs_only) {
+            return PolyMulDense(p, q);
+        }
+        return PolyMulHash(p, q, range);
+    }
+    return PolyMulHeap(p, q);
+}
+
+void PolyMulAssign(Poly *acc, Poly *take) {
+    if (PolyIsCoeff(acc)) {
+        Poly tmp = *acc;
+        *acc = *take;
+        *take = tmp;
+    }
+
+    if (PolyIsCoeff(take)) {
+        PolyMulByCoeffAssign(acc, take->coeff);
+    } else {
+        Poly res = PolyMul(acc, take);
+        PolyDestroy(acc);
+        PolyDestroy(take);
+        *acc = res;
+    }
+
+    *take = PolyZero();
+}
+
 /**
  * Pomocnicza funkcja do obliczania potęgi całkowitej 
  * 
@@ -459,44 +2328,166 @@ static poly_coeff_t CoeffPow(poly_coeff_t x, poly_exp_t p) {
 Poly PolyAt(const Poly *p, poly_coeff_t x) {
     if (PolyIsCoeff(p)) return PolyClone(p);
 
-    Poly res = PolyZero();
+    // schemat Hornera względem różnic kolejnych wykładników:
+    // c_0 x^{e_0} + ... + c_{n-1} x^{e_{n-1}} =
+    // ((c_0 x^{e_0 - e_1} + c_1) x^{e_1 - e_2} + ...) x^{e_{n-1}}
+    const Mono *arr = p->arr;
+    size_t last = p->size - 1;
+
+    if (MonoArrayHasCoeffsOnly(arr, p->size)) {
+        poly_coeff_t res = arr[0].p.coeff;
+        for (size_t i = 1; i <= last; i++) {
+            poly_exp_t gap = MonoGetExp(&arr[i-1]) - MonoGetExp(&arr[i]);
+            res = res * CoeffPow(x, gap) + arr[i].p.coeff;
+        }
+        return PolyFromCoeff(res * CoeffPow(x, MonoGetExp(&arr[last])));
+    }
 
-    for (size_t i = 0; i < p->size; i++) {
-        Poly poly_x = PolyFromCoeff(CoeffPow(x, MonoGetExp(&p->arr[i])));
-        Poly poly_coeff = PolyMul(&p->arr[i].p, &poly_x);
+    Poly res = PolyClone(&arr[0].p);
 
-        Poly tmp_res = PolyAdd(&res, &poly_coeff);
-        PolyDestroy(&poly_coeff);
-        PolyDestroy(&res);
-        res = tmp_res;
+    for (size_t i = 1; i <= last; i++) {
+        poly_exp_t gap = MonoGetExp(&arr[i-1]) - MonoGetExp(&arr[i]);
+        PolyMulByCoeffAssign(&res, CoeffPow(x, gap));
+
+        Poly poly_coeff = PolyClone(&arr[i].p);
+        PolyAddAssign(&res, &poly_coeff);
     }
 
+    PolyMulByCoeffAssign(&res, CoeffPow(x, MonoGetExp(&arr[last])));
     return res;
 }
 
+poly_coeff_t PolyEval(const Poly *p, size_t k, const poly_coeff_t x[]) {
+    if (PolyIsCoeff(p)) return p->coeff;
+
+    // zmienne, dla których nie podano wartości, są zerami
+    poly_coeff_t x0 = k > 0 ? x[0] : 0;
+    size_t next_k = k > 0 ? k - 1 : 0;
+    const poly_coeff_t *next_x = k > 0 ? x + 1 : x;
+
+    // schemat Hornera, jak w funkcji PolyAt
+    const Mono *arr = p->arr;
+    size_t last = p->size - 1;
+    poly_coeff_t res = PolyEval(&arr[0].p, next_k, next_x);
+
+    for (size_t i = 1; i <= last; i++) {
+        poly_exp_t gap = MonoGetExp(&arr[i-1]) - MonoGetExp(&arr[i]);
+        res = res * CoeffPow(x0, gap) + PolyEval(&arr[i].p, next_k, next_x);
+    }
+
+    return res * CoeffPow(x0, MonoGetExp(&arr[last]));
+}
+
 /**
- * Oblicza potęgę wielomianu.
- * @param[in] p : wielomian @f$p@f$
- * @param[in] exp : wykładnik @f$exp@f$
- * @return @f$p^{exp}@f$
- */ 
-static Poly PolyPow(const Poly *p, poly_exp_t exp) {
-    if (exp == 0) return PolyFromCoeff(1);
-    if (exp == 0) return PolyClone(p);
+ * Struktura przechowująca obliczone potęgi wielomianu podstawianego pod
+ * jedną zmienną w trakcie jednego wywołania funkcji `PolyCompose`.
+ * Potęgi są posortowane rosnąco względem wykładnika.
+ */
+typedef struct PowCache {
+    const Poly *base;  ///< podstawa potęg
+    size_t size;       ///< liczba obliczonych potęg
+    size_t capacity;   ///< rozmiar zaalokowanych tablic
+    poly_exp_t *exps;  ///< wykładniki obliczonych potęg
+    Poly *pows;        ///< obliczone potęgi
+} PowCache;
 
-    Poly tmp = PolyPow(p, exp/2);
+/**
+ * Znajduje w pamięci podręcznej potęgę o największym wykładniku nie
+ * większym niż @p exp .
+ * @param[in] c : pamięć podręczna potęg, zawierająca potęgę o wykładniku 0
+ * @param[in] exp : wykładnik
+ * @return indeks znalezionej potęgi
+ */
+static size_t PowCacheFind(const PowCache *c, poly_exp_t exp) {
+    size_t lo = 0, hi = c->size;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (c->exps[mid] <= exp) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
 
-    if (exp % 2 == 0) {
-        Poly res = PolyMul(&tmp, &tmp);
-        PolyDestroy(&tmp);
-        return res;
+/**
+ * Dodaje potęgę do pamięci podręcznej, przejmując ją na własność.
+ * @param[in,out] c : pamięć podręczna potęg
+ * @param[in] exp : wykładnik potęgi
+ * @param[in] pow : potęga
+ * @return wskaźnik na potęgę przechowywaną w pamięci podręcznej
+ */
+static const Poly *PowCacheInsert(PowCache *c, poly_exp_t exp, Poly pow) {
+    if (c->size == c->capacity) {
+        c->capacity = 1 + 2 * c->capacity;
+        c->exps = (poly_exp_t*) realloc(c->exps,
+                                        c->capacity * sizeof(poly_exp_t));
+        c->pows = (Poly*) realloc(c->pows, c->capacity * sizeof(Poly));
+        CheckPtr(c->exps);
+        CheckPtr(c->pows);
+    }
+
+    size_t pos = c->size;
+    while (pos > 0 && c->exps[pos-1] > exp) {
+        c->exps[pos] = c->exps[pos-1];
+        c->pows[pos] = c->pows[pos-1];
+        pos--;
+    }
+    c->exps[pos] = exp;
+    c->pows[pos] = pow;
+    c->size++;
+
+    return &c->pows[pos];
+}
+
+/**
+ * Zwraca potęgę podstawy przechowywanej w pamięci podręcznej, obliczając ją
+ * w razie potrzeby. Nowa potęga jest liczona z najbliższej mniejszej
+ * obliczonej potęgi @f$q^{e'}@f$ jako @f$q^{e'} q^{e - e'}@f$, jeśli
+ * @f$e' \geq e/2@f$, a w przeciwnym przypadku przez podniesienie do kwadratu
+ * @f$q^{\lfloor e/2 \rfloor}@f$. Wszystkie obliczone potęgi są zapamiętywane.
+ * Zwrócony wskaźnik jest ważny do kolejnego wywołania tej funkcji.
+ * @param[in,out] c : pamięć podręczna potęg
+ * @param[in] exp : wykładnik @f$e@f$
+ * @return @f$q^e@f$
+ */
+static const Poly *PowCacheGet(PowCache *c, poly_exp_t exp) {
+    if (c->size == 0) {
+        PowCacheInsert(c, 0, PolyFromCoeff(1));
+        PowCacheInsert(c, 1, PolyClone(c->base));
+    }
+
+    size_t pos = PowCacheFind(c, exp);
+    poly_exp_t lower = c->exps[pos];
+    if (lower == exp) {
+        return &c->pows[pos];
+    }
+
+    Poly res;
+    if (lower >= exp - lower) {
+        const Poly *diff_pow = PowCacheGet(c, exp - lower);
+        // obliczenie potęgi mogło przesunąć elementy pamięci podręcznej
+        res = PolyMul(&c->pows[PowCacheFind(c, lower)], diff_pow);
     } else {
-        Poly tmp2 = PolyMul(&tmp, &tmp);
-        Poly res = PolyMul(p, &tmp2);
-        PolyDestroy(&tmp);
-        PolyDestroy(&tmp2);
-        return res; 
+        const Poly *half_pow = PowCacheGet(c, exp / 2);
+        res = PolyMul(half_pow, half_pow);
+        if (exp % 2 != 0) {
+            Poly base = PolyClone(c->base);
+            PolyMulAssign(&res, &base);
+        }
     }
+
+    return PowCacheInsert(c, exp, res);
+}
+
+/**
+ * Usuwa z pamięci wszystkie potęgi przechowywane w pamięci podręcznej.
+ * @param[in] c : pamięć podręczna potęg
+ */
+static void PowCacheDestroy(PowCache *c) {
+    for (size_t i = 0; i < c->size; i++) {
+        PolyDestroy(&c->pows[i]);
+    }
+    free(c->exps);
+    free(c->pows);
 }
 
 /**
@@ -516,25 +2507,185 @@ static Poly PolyComposeZero(const Poly *p) {
     return PolyZero();
 }
 
-Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
-    if (k == 0) return PolyComposeZero(p);
-    if (PolyIsCoeff(p)) return PolyClone(p);
- 
-    Poly res = PolyZero();
+static Poly PolyComposeCached(const Poly *p, size_t k, PowCache caches[]);
 
-    for (size_t i = 0; i < p->size; i++) {
-        Poly coeff_poly = PolyCompose(&p->arr[i].p, k-1, q+1);
-        Poly exp_poly = PolyPow(q, p->arr[i].exp);
-        Poly mul_res = PolyMul(&coeff_poly, &exp_poly);
-        Poly tmp = PolyAdd(&res, &mul_res);
-
-        PolyDestroy(&coeff_poly);
-        PolyDestroy(&exp_poly);
-        PolyDestroy(&mul_res);
+/**
+ * Wykonuje operację złożenia sumy jednomianów z wielomianami, korzystając
+ * z pamięci podręcznej potęg wielomianów @f$q_i@f$. Dla
+ * @f$\sum c_j x_0^{e_j}@f$ wynik jest liczony schematem Hornera, jak
+ * w funkcji `PolyAt`, mnożąc kolejne sumy częściowe przez
+ * @f$q_0^{e_j - e_{j+1}}@f$.
+ * @param[in] arr : jednomiany posortowane malejąco względem wykładników
+ * @param[in] count : liczba jednomianów, dodatnia
+ * @param[in] k : liczba wielomianów, dodatnia
+ * @param[in,out] caches : pamięci podręczne potęg wielomianów @f$q_i@f$
+ * @return @f$\sum c_j(q_1, q_2, \ldots) q_0^{e_j}@f$
+ */
+static Poly PolyComposeMonos(const Mono arr[], size_t count, size_t k,
+                             PowCache caches[]) {
+    size_t last = count - 1;
+    Poly res = PolyComposeCached(&arr[0].p, k-1, caches+1);
+
+    for (size_t i = 1; i <= last; i++) {
+        poly_exp_t gap = MonoGetExp(&arr[i-1]) - MonoGetExp(&arr[i]);
+        Poly tmp = PolyMul(&res, PowCacheGet(&caches[0], gap));
         PolyDestroy(&res);
+        res = tmp;
+
+        Poly coeff_poly = PolyComposeCached(&arr[i].p, k-1, caches+1);
+        PolyAddAssign(&res, &coeff_poly);
+    }
 
+    if (MonoGetExp(&arr[last]) > 0) {
+        const Poly *pow = PowCacheGet(&caches[0], MonoGetExp(&arr[last]));
+        Poly tmp = PolyMul(&res, pow);
+        PolyDestroy(&res);
         res = tmp;
     }
-    
+
+    return res;
+}
+
+/**
+ * Wykonuje operację złożenia wielomianów, korzystając z pamięci podręcznej
+ * potęg wielomianów @f$q_i@f$.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wielomianów
+ * @param[in,out] caches : pamięci podręczne potęg wielomianów @f$q_i@f$
+ * @return @f$p(q_0, q_1, q_2, \ldots)@f$
+ */
+static Poly PolyComposeCached(const Poly *p, size_t k, PowCache caches[]) {
+    if (k == 0) return PolyComposeZero(p);
+    if (PolyIsCoeff(p)) return PolyClone(p);
+
+    return PolyComposeMonos(p->arr, p->size, k, caches);
+}
+
+/**
+ * Najmniejsza liczba wyrazów wielomianu @f$p@f$ (po rozwinięciu do sumy
+ * jednomianów wszystkich zmiennych), przy której złożenie jest rozdzielane
+ * na wątki.
+ */
+#define PARALLEL_COMPOSE_MIN_TERMS 64
+
+/**
+ * Liczba fragmentów wielomianu @f$p@f$ przypadających na jeden wątek przy
+ * równoległym złożeniu. Więcej fragmentów niż wątków pozwala wątkom
+ * wyrównywać obciążenie przez kradzież zadań.
+ */
+#define PARALLEL_COMPOSE_CHUNKS 4
+
+/**
+ * Struktura opisująca zadania równoległego złożenia wielomianów.
+ */
+typedef struct ParallelCompose {
+    const Mono *arr;        ///< jednomiany wielomianu @f$p@f$
+    const size_t *bounds;   ///< granice fragmentów tablicy `arr`
+    size_t k;               ///< liczba wielomianów
+    const PowCache *caches; ///< pamięci podręczne; potęgi @f$q_0@f$ są gotowe
+    Poly *parts;            ///< złożenia fragmentów
+} ParallelCompose;
+
+/**
+ * Składa fragment wielomianu @f$p@f$ z wielomianami. Potęgi @f$q_0@f$ są
+ * tylko odczytywane ze wspólnej pamięci podręcznej, a potęgi pozostałych
+ * wielomianów są liczone we własnych pamięciach podręcznych zadania.
+ * @param[in] arg : opis złożenia (`ParallelCompose`)
+ * @param[in] i : indeks fragmentu
+ */
+static void ParallelComposeTask(void *arg, size_t i) {
+    ParallelCompose *comp = (ParallelCompose*) arg;
+    PowCache *caches = (PowCache*) calloc(comp->k + 1, sizeof(PowCache));
+    CheckPtr(caches);
+    caches[0] = comp->caches[0];
+    for (size_t j = 1; j < comp->k; j++) {
+        caches[j].base = comp->caches[j].base;
+    }
+
+    comp->parts[i] = PolyComposeMonos(comp->arr + comp->bounds[i],
+                                      comp->bounds[i+1] - comp->bounds[i],
+                                      comp->k, caches);
+
+    for (size_t j = 1; j < comp->k; j++) {
+        PowCacheDestroy(&caches[j]);
+    }
+    free(caches);
+}
+
+/**
+ * Wykonuje operację złożenia wielomianów na wielu wątkach, jeśli się to
+ * opłaca. Dzieli jednomiany wielomianu @f$p@f$ na spójne fragmenty, oblicza
+ * wcześniej wszystkie potrzebne fragmentom potęgi @f$q_0@f$, składa
+ * fragmenty niezależnie i sumuje wyniki w drzewie.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wielomianów
+ * @param[in,out] caches : pamięci podręczne potęg wielomianów @f$q_i@f$
+ * @param[out] res : @f$p(q_0, q_1, q_2, \ldots)@f$, jeśli złożenie zostało
+ * wykonane
+ * @return czy złożenie zostało wykonane?
+ */
+static bool PolyComposeParallel(const Poly *p, size_t k, PowCache caches[],
+                                Poly *res) {
+    size_t threads = PolyGetThreads();
+    if (threads <= 1 || k == 0 || PolyIsCoeff(p) || p->size < 2 ||
+        PolyInParallel())
+    {
+        return false;
+    }
+
+    size_t terms = 0;
+    PolyDepth(p, &terms);
+    if (terms < PARALLEL_COMPOSE_MIN_TERMS) return false;
+
+    size_t count = threads * PARALLEL_COMPOSE_CHUNKS;
+    if (count > p->size) count = p->size;
+    size_t *bounds = (size_t*) malloc((count + 1) * sizeof(size_t));
+    Poly *parts = (Poly*) malloc(count * sizeof(Poly));
+    CheckPtr(bounds);
+    CheckPtr(parts);
+
+    // zadania nie mogą modyfikować wspólnej pamięci podręcznej
+    for (size_t i = 0; i <= count; i++) {
+        bounds[i] = i * p->size / count;
+    }
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = bounds[i] + 1; j < bounds[i+1]; j++) {
+            PowCacheGet(&caches[0],
+                        MonoGetExp(&p->arr[j-1]) - MonoGetExp(&p->arr[j]));
+        }
+        if (MonoGetExp(&p->arr[bounds[i+1] - 1]) > 0) {
+            PowCacheGet(&caches[0], MonoGetExp(&p->arr[bounds[i+1] - 1]));
+        }
+    }
+
+    ParallelCompose comp = {
+        .arr = p->arr, .bounds = bounds, .k = k, .caches = caches,
+        .parts = parts
+    };
+    PolyParallelFor(count, ParallelComposeTask, &comp);
+    *res = PolySumParallel(count, parts);
+
+    free(bounds);
+    free(parts);
+    return true;
+}
+
+Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
+    PowCache *caches = (PowCache*) calloc(k + 1, sizeof(PowCache));
+    CheckPtr(caches);
+    for (size_t i = 0; i < k; i++) {
+        caches[i].base = &q[i];
+    }
+
+    Poly res;
+    if (!PolyComposeParallel(p, k, caches, &res)) {
+        res = PolyComposeCached(p, k, caches);
+    }
+
+    for (size_t i = 0; i < k; i++) {
+        PowCacheDestroy(&caches[i]);
+    }
+    free(caches);
+
     return res;
 }
@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /** To jest typ reprezentujący współczynniki. */
 typedef long poly_coeff_t;
@@ -52,6 +53,16 @@ typedef struct Mono {
   poly_exp_t exp; ///< wykładnik
 } Mono;
 
+/**
+ * Włącza lub wyłącza współdzielenie tablic jednomianów przez kopie
+ * wielomianów (domyślnie włączone). Przy włączonym współdzieleniu funkcja
+ * `PolyClone` działa w czasie stałym, a wspólna tablica jest kopiowana
+ * dopiero przy modyfikacji jednej z kopii w miejscu. W przeciwnym przypadku
+ * kopie są zawsze pełne i głębokie.
+ * @param[in] enabled : czy współdzielenie ma być włączone?
+ */
+void PolySetSharing(bool enabled);
+
 /**
  * Daje wartość wykładnika jendomianu.
  * @param[in] m : jednomian
@@ -125,7 +136,9 @@ static inline void MonoDestroy(Mono *m) {
 }
 
 /**
- * Zwalnia z pamięci tablicę jednomianów.
+ * Usuwa z pamięci jednomiany z tablicy i zwalnia tablicę, zaalokowaną
+ * za pomocą aktualnego alokatora. Nie służy do usuwania tablicy jednomianów
+ * należącej do wielomianu.
  *
  * @param[in] arr : tablica jednomianów
  * @param[in] size : liczba jednomianów
@@ -133,14 +146,16 @@ static inline void MonoDestroy(Mono *m) {
 void DestroyMonoArray(Mono *arr, size_t size);
 
 /**
- * Robi pełną, głęboką kopię wielomianu.
+ * Robi kopię wielomianu. Jeśli współdzielenie jest włączone (zob.
+ * `PolySetSharing`), kopia współdzieli tablicę jednomianów z wielomianem
+ * @p p , a w przeciwnym przypadku jest pełną, głęboką kopią.
  * @param[in] p : wielomian
  * @return skopiowany wielomian
  */
 Poly PolyClone(const Poly *p);
 
 /**
- * Robi pełną, głęboką kopię jednomianu.
+ * Robi kopię jednomianu, tak jak funkcja `PolyClone`.
  * @param[in] m : jednomian
  * @return skopiowany jednomian
  */
@@ -169,8 +184,9 @@ Poly PolyAddMonos(size_t count, const Mono monos[]);
  * Sumuje listę jednomianów i tworzy z nich wielomian. Przejmuje na własność
  * pamięć wskazywaną przez @p monos i jej zawartość. Może dowolnie modyfikować
  * zawartość tej pamięci. Zakładamy, że pamięć wskazywana przez @p monos
- * została zaalokowana na stercie. Jeśli @p count lub @p monos jest równe zeru
- * (NULL), tworzy wielomian tożsamościowo równy zeru.
+ * została zaalokowana za pomocą aktualnego alokatora (domyślnie na stercie).
+ * Jeśli @p count lub @p monos jest równe zeru (NULL), tworzy wielomian
+ * tożsamościowo równy zeru.
  * @param[in] count : liczba jednomianów
  * @param[in] monos : tablica jednomianów
  * @return wielomian będący sumą jednomianów
@@ -188,6 +204,56 @@ Poly PolyOwnMonos(size_t count, Mono *monos);
  */
 Poly PolyCloneMonos(size_t count, const Mono monos[]);
 
+/**
+ * To jest struktura służąca do budowania wielomianu przez dodawanie do niego
+ * kolejnych jednomianów. Jednomiany trafiają do bufora o stałym rozmiarze.
+ * Pełny bufor jest upraszczany do posortowanej serii, a serie są scalane
+ * parami w serie dwa razy dłuższe (jak w drzewie LSM), więc jednomiany
+ * o tym samym wykładniku są sumowane wcześnie, a pamięć zależy od liczby
+ * różnych wyrazów, a nie od liczby dodanych jednomianów. Jednomiany
+ * podawane w kolejności rosnących lub malejących wykładników trafiają od
+ * razu do tablicy jednomianów wyniku, bez kopiowania i sortowania.
+ */
+typedef struct PolyBuilder PolyBuilder;
+
+/**
+ * Rozpoczyna budowanie wielomianu.
+ * @return budowniczy pustej sumy jednomianów
+ */
+PolyBuilder *PolyBuilderBegin(void);
+
+/**
+ * Dodaje jednomian do budowanego wielomianu. Przejmuje jednomian na własność.
+ * @param[in,out] b : budowniczy wielomianu
+ * @param[in] m : jednomian
+ */
+void PolyBuilderAddMono(PolyBuilder *b, Mono *m);
+
+/**
+ * Dodaje do budowanego wielomianu wyraz
+ * @f$c x_0^{e_0} x_1^{e_1} \cdots x_{k-1}^{e_{k-1}}@f$.
+ * @param[in,out] b : budowniczy wielomianu
+ * @param[in] k : liczba wykładników
+ * @param[in] exps : wykładniki @f$e_i@f$ kolejnych zmiennych
+ * @param[in] coeff : współczynnik @f$c@f$
+ */
+void PolyBuilderAddTerm(PolyBuilder *b, size_t k, const poly_exp_t exps[],
+                        poly_coeff_t coeff);
+
+/**
+ * Kończy budowanie wielomianu i usuwa budowniczego z pamięci.
+ * @param[in] b : budowniczy wielomianu
+ * @return suma dodanych jednomianów
+ */
+Poly PolyBuilderFinish(PolyBuilder *b);
+
+/**
+ * Przerywa budowanie wielomianu, usuwając z pamięci budowniczego i dodane
+ * jednomiany.
+ * @param[in] b : budowniczy wielomianu
+ */
+void PolyBuilderDestroy(PolyBuilder *b);
+
 /**
  * Mnoży dwa wielomiany.
  * @param[in] p : wielomian @f$p@f$
@@ -211,6 +277,35 @@ Poly PolyNeg(const Poly *p);
  */
 Poly PolySub(const Poly *p, const Poly *q);
 
+/**
+ * Dodaje wielomian @p take do wielomianu @p acc , zapisując wynik w @p acc .
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p take
+ * i wykorzystuje ponownie pamięć obu wielomianów zamiast ich kopiowania.
+ * Po wykonaniu funkcji @p take jest wielomianem tożsamościowo równym zeru.
+ * @param[in,out] acc : wielomian @f$p@f$, zastępowany przez @f$p + q@f$
+ * @param[in] take : wielomian @f$q@f$
+ */
+void PolyAddAssign(Poly *acc, Poly *take);
+
+/**
+ * Odejmuje wielomian @p take od wielomianu @p acc , zapisując wynik w @p acc .
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p take .
+ * Po wykonaniu funkcji @p take jest wielomianem tożsamościowo równym zeru.
+ * @param[in,out] acc : wielomian @f$p@f$, zastępowany przez @f$p - q@f$
+ * @param[in] take : wielomian @f$q@f$
+ */
+void PolySubAssign(Poly *acc, Poly *take);
+
+/**
+ * Mnoży wielomian @p acc przez wielomian @p take , zapisując wynik w @p acc .
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p take .
+ * Mnożenie przez wielomian stały odbywa się w miejscu, bez kopiowania.
+ * Po wykonaniu funkcji @p take jest wielomianem tożsamościowo równym zeru.
+ * @param[in,out] acc : wielomian @f$p@f$, zastępowany przez @f$p * q@f$
+ * @param[in] take : wielomian @f$q@f$
+ */
+void PolyMulAssign(Poly *acc, Poly *take);
+
 /**
  * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
  * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
@@ -238,6 +333,16 @@ poly_exp_t PolyDeg(const Poly *p);
  */
 bool PolyIsEq(const Poly *p, const Poly *q);
 
+/**
+ * Zwraca skrót wielomianu. Równe wielomiany mają równe skróty, więc skrót
+ * może służyć jako klucz w tablicach haszujących. Skrót wielomianu, który
+ * nie jest stały, jest obliczany przy pierwszym użyciu i zapamiętywany do
+ * czasu modyfikacji wielomianu przez funkcje biblioteki.
+ * @param[in] p : wielomian
+ * @return skrót wielomianu @p p
+ */
+uint64_t PolyHash(const Poly *p);
+
 /**
  * Wylicza wartość wielomianu w punkcie @p x.
  * Wstawia pod pierwszą zmienną wielomianu wartość @p x.
@@ -251,6 +356,18 @@ bool PolyIsEq(const Poly *p, const Poly *q);
  */
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
+/**
+ * Wylicza wartość wielomianu w punkcie @f$(x_0, x_1, \ldots, x_{k-1})@f$.
+ * Jeśli liczba @f$k@f$ wartości jest mniejsza niż liczba @f$l@f$ zmiennych
+ * wielomianu @f$p@f$, wówczas pod zmienne @f$x_k, \ldots, x_{l-1}@f$
+ * podstawiane są zera. Nie alokuje pamięci.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wartości
+ * @param[in] x : tablica wartości @f$x_i@f$
+ * @return @f$p(x_0, x_1, \ldots, x_{k-1}, 0, \ldots, 0)@f$
+ */
+poly_coeff_t PolyEval(const Poly *p, size_t k, const poly_coeff_t x[]);
+
 /**
  * Wykonuje operację złożenia wielomianów przez podstawienie w wielomianie
  * @f$p@f$ pod zmienną @f$x_i@f$ odpowiednio wielomianu @f$q_i@f$.
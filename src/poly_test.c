@@ -3,13 +3,19 @@
 #endif
 
 #include "poly.h"
+#include "dist.h"
+#include "eval.h"
+#include "parallel.h"
+#include "parser.h"
 #include <assert.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 /** DANE DO TESTÓW **/
 
@@ -3968,6 +3974,931 @@ static bool MemoryFreeTest(void) {
   return res;
 }
 
+/**
+ * Sprawdza, czy funkcje PolyAddAssign, PolySubAssign i PolyMulAssign dają
+ * te same wyniki co PolyAdd, PolySub i PolyMul oraz czy przejmują na
+ * własność drugi argument.
+ */
+static bool AssignTest(void) {
+  bool res = true;
+  Poly polys[] = {
+    C(0),
+    C(5),
+    P(C(1), 0, C(2), 3),
+    P(C(-1), 0, C(-2), 3),
+    P(P(C(1), 1), 0, C(1), 2),
+    P(C(3), 1, P(C(1), 0, C(-1), 2), 4, C(1), 7),
+    P(P(C(1), 1, C(2), 5), 2, C(-1), 4, C(1), 7),
+  };
+  for (size_t i = 0; i < sizeof polys / sizeof polys[0]; ++i) {
+    for (size_t j = 0; j < sizeof polys / sizeof polys[0]; ++j) {
+      Poly (*ops[])(const Poly *, const Poly *) = {PolyAdd, PolySub, PolyMul};
+      void (*assign_ops[])(Poly *, Poly *) = {
+        PolyAddAssign, PolySubAssign, PolyMulAssign
+      };
+      for (size_t k = 0; k < 3; ++k) {
+        Poly expected = ops[k](&polys[i], &polys[j]);
+        Poly acc = PolyClone(&polys[i]);
+        Poly take = PolyClone(&polys[j]);
+        assign_ops[k](&acc, &take);
+        res &= PolyIsEq(&acc, &expected);
+        res &= PolyIsZero(&take);
+        PolyDestroy(&acc);
+        PolyDestroy(&expected);
+      }
+    }
+  }
+  for (size_t i = 0; i < sizeof polys / sizeof polys[0]; ++i)
+    PolyDestroy(&polys[i]);
+  return res;
+}
+
+/**
+ * Sprawdza, czy PolyEval daje ten sam wynik co kolejne wywołania PolyAt,
+ * również gdy podano mniej wartości niż jest zmiennych.
+ */
+static bool EvalTest(void) {
+  bool res = true;
+  Poly p = P(P(C(1), 0, P(C(2), 1, C(-1), 3), 2), 1, C(3), 4,
+             P(C(-5), 0, C(7), 2), 6);
+  const poly_coeff_t x[] = {2, -3, 5};
+  for (size_t k = 0; k <= 3; ++k) {
+    Poly q = PolyClone(&p);
+    for (size_t i = 0; i < 3; ++i) {
+      Poly tmp = PolyAt(&q, i < k ? x[i] : 0);
+      PolyDestroy(&q);
+      q = tmp;
+    }
+    res &= PolyIsCoeff(&q) && PolyEval(&p, k, x) == q.coeff;
+    PolyDestroy(&q);
+  }
+  PolyDestroy(&p);
+  p = C(42);
+  res &= PolyEval(&p, 0, NULL) == 42;
+  p = P(C(1), 64);
+  res &= PolyEval(&p, 1, x) == 0;
+  PolyDestroy(&p);
+  return res;
+}
+
+/**
+ * Sprawdza, czy PolyEvalBatch daje te same wyniki co PolyEval dla liczby
+ * punktów niebędącej wielokrotnością rozmiaru bloku.
+ */
+static bool EvalBatchTest(void) {
+  bool res = true;
+  const size_t nvars = 3;
+  const size_t npoints = 1001;
+  int exp_shift = 0;
+  int coef_shift = 0;
+  Poly p = RecursiveBuild(3, &exp_shift, &coef_shift);
+  Poly polys[] = {C(0), C(-7), P(C(1), 64), p};
+  poly_coeff_t *xs = calloc(npoints * nvars, sizeof (poly_coeff_t));
+  poly_coeff_t *out = calloc(npoints, sizeof (poly_coeff_t));
+  CHECK_PTR(xs);
+  CHECK_PTR(out);
+  for (size_t i = 0; i < npoints * nvars; ++i)
+    xs[i] = coef_arr1[i % conf_size] % 7;
+  for (size_t i = 0; i < sizeof polys / sizeof polys[0]; ++i) {
+    for (size_t k = 0; k <= nvars; ++k) {
+      poly_coeff_t *ks_xs = calloc(npoints * (k + 1), sizeof (poly_coeff_t));
+      CHECK_PTR(ks_xs);
+      for (size_t j = 0; j < npoints; ++j)
+        memcpy(ks_xs + j * k, xs + j * nvars, k * sizeof (poly_coeff_t));
+      PolyEvalBatch(&polys[i], k, npoints, ks_xs, out);
+      for (size_t j = 0; j < npoints; ++j)
+        res &= out[j] == PolyEval(&polys[i], k, ks_xs + j * k);
+      free(ks_xs);
+    }
+  }
+  for (size_t i = 0; i < sizeof polys / sizeof polys[0]; ++i)
+    PolyDestroy(&polys[i]);
+  free(xs);
+  free(out);
+  return res;
+}
+
+/**
+ * Sprawdza, czy skompilowany wielomian daje te same wartości co PolyEval,
+ * również po usunięciu wielomianu, z którego został skompilowany.
+ */
+static bool ProgramTest(void) {
+  bool res = true;
+  const size_t nvars = 3;
+  const size_t npoints = 100;
+  int exp_shift = 0;
+  int coef_shift = 0;
+  Poly p = RecursiveBuild(3, &exp_shift, &coef_shift);
+  poly_coeff_t xs[npoints * nvars];
+  poly_coeff_t expected[npoints];
+  poly_coeff_t out[npoints];
+  for (size_t i = 0; i < npoints * nvars; ++i)
+    xs[i] = coef_arr2[i] % 5;
+  for (size_t j = 0; j < npoints; ++j)
+    expected[j] = PolyEval(&p, nvars, xs + j * nvars);
+  PolyProgram *prog = PolyProgramCompile(&p, nvars);
+  PolyDestroy(&p);
+  for (size_t j = 0; j < npoints; ++j)
+    res &= PolyProgramEval(prog, xs + j * nvars) == expected[j];
+  PolyProgramEvalBatch(prog, npoints, xs, out);
+  for (size_t j = 0; j < npoints; ++j)
+    res &= out[j] == expected[j];
+  PolyProgramDestroy(prog);
+  return res;
+}
+
+/**
+ * Sprawdza PolyCompose, porównując wartości złożenia w kilku punktach
+ * z wartościami wielomianu w punktach będących wartościami wielomianów
+ * podstawianych pod zmienne.
+ */
+static bool ComposeTest(void) {
+  bool res = true;
+  Poly p = P(P(C(1), 0, C(-2), 3), 0, C(3), 2, P(C(1), 1, C(5), 4), 7,
+             C(-1), 12);
+  Poly q[] = {
+    P(C(1), 0, P(C(1), 1), 1),
+    P(C(2), 0, C(-1), 2),
+    P(P(C(1), 2), 1),
+  };
+  const size_t nq = sizeof q / sizeof q[0];
+  const poly_coeff_t points[][2] = {{1, 1}, {2, -1}, {-3, 2}, {0, 5}};
+  for (size_t k = 0; k <= nq; ++k) {
+    Poly composed = PolyCompose(&p, k, q);
+    for (size_t j = 0; j < sizeof points / sizeof points[0]; ++j) {
+      poly_coeff_t q_vals[nq + 1];
+      for (size_t i = 0; i < k; ++i)
+        q_vals[i] = PolyEval(&q[i], 2, points[j]);
+      res &= PolyEval(&composed, 2, points[j]) == PolyEval(&p, k, q_vals);
+    }
+    PolyDestroy(&composed);
+  }
+  PolyDestroy(&p);
+  for (size_t i = 0; i < nq; ++i)
+    PolyDestroy(&q[i]);
+  return res;
+}
+
+/**
+ * Sprawdza, czy kopie wielomianu współdzielą tablicę jednomianów, czy
+ * modyfikacja kopii w miejscu nie zmienia oryginału oraz czy przy wyłączonym
+ * współdzieleniu lub innym alokatorze kopie są głębokie.
+ */
+static bool SharingTest(void) {
+  bool res = true;
+  Poly p = P(P(C(1), 1, C(2), 5), 2, C(-1), 4, C(1), 7);
+  Poly expected = P(P(C(1), 1, C(2), 5), 2, C(-1), 4, C(1), 7);
+
+  Poly q = PolyClone(&p);
+  res &= q.arr == p.arr && PolyIsEq(&p, &q);
+  Poly take = P(P(C(1), 1), 2);
+  PolyAddAssign(&q, &take);
+  Poly sum = P(P(C(2), 1, C(2), 5), 2, C(-1), 4, C(1), 7);
+  res &= PolyIsEq(&q, &sum) && PolyIsEq(&p, &expected);
+  PolyDestroy(&q);
+  PolyDestroy(&sum);
+
+  q = PolyClone(&p);
+  take = C(3);
+  PolyMulAssign(&q, &take);
+  Poly prod = P(P(C(3), 1, C(6), 5), 2, C(-3), 4, C(3), 7);
+  res &= PolyIsEq(&q, &prod) && PolyIsEq(&p, &expected);
+  PolyDestroy(&q);
+  PolyDestroy(&prod);
+
+  q = PolyClone(&p);
+  take = PolyClone(&p);
+  PolySubAssign(&q, &take);
+  res &= PolyIsZero(&q) && PolyIsEq(&p, &expected);
+
+  PolySetSharing(false);
+  q = PolyClone(&p);
+  res &= q.arr != p.arr && PolyIsEq(&p, &q);
+  PolyDestroy(&q);
+  PolySetSharing(true);
+
+  PolyDestroy(&p);
+  PolyDestroy(&expected);
+  return res;
+}
+
+/**
+ * Sprawdza, czy zamiana na postać rozłożoną i z powrotem zachowuje
+ * wielomian oraz czy dodawanie, mnożenie i wyliczanie wartości w postaci
+ * rozłożonej dają te same wyniki co odpowiednie funkcje z `poly.h`.
+ */
+static bool DistTest(void) {
+  bool res = true;
+  Poly polys[] = {
+    C(0),
+    C(-7),
+    P(C(1), 0, C(2), 3),
+    P(C(-1), 0, C(-2), 3),
+    P(P(C(1), 1), 0, C(1), 2),
+    P(C(3), 1, P(C(1), 0, C(-1), 2), 4, C(1), 7),
+    P(P(P(C(1), 1, P(C(2), 3), 5), 2), 0, C(-1), 4,
+      P(C(1), 0, P(P(P(C(4), 2), 1), 6), 1), 7),
+  };
+  const size_t n = sizeof polys / sizeof polys[0];
+  const poly_coeff_t x[] = {2, -3, 5, 7, -11};
+  for (size_t i = 0; i < n; ++i) {
+    PolyDist *a = PolyDistFromPoly(&polys[i]);
+    Poly back = PolyDistToPoly(a);
+    res &= PolyIsEq(&back, &polys[i]);
+    res &= PolyDistEval(a, 5, x) == PolyEval(&polys[i], 5, x);
+    res &= PolyDistEval(a, 2, x) == PolyEval(&polys[i], 2, x);
+    PolyDestroy(&back);
+    for (size_t j = 0; j < n; ++j) {
+      PolyDist *b = PolyDistFromPoly(&polys[j]);
+      PolyDist *sum = PolyDistAdd(a, b);
+      PolyDist *prod = PolyDistMul(a, b);
+      Poly sum_poly = PolyDistToPoly(sum);
+      Poly prod_poly = PolyDistToPoly(prod);
+      Poly expected_sum = PolyAdd(&polys[i], &polys[j]);
+      Poly expected_prod = PolyMul(&polys[i], &polys[j]);
+      res &= PolyIsEq(&sum_poly, &expected_sum);
+      res &= PolyIsEq(&prod_poly, &expected_prod);
+      PolyDestroy(&sum_poly);
+      PolyDestroy(&prod_poly);
+      PolyDestroy(&expected_sum);
+      PolyDestroy(&expected_prod);
+      PolyDistDestroy(sum);
+      PolyDistDestroy(prod);
+      PolyDistDestroy(b);
+    }
+    PolyDistDestroy(a);
+  }
+  for (size_t i = 0; i < n; ++i)
+    PolyDestroy(&polys[i]);
+
+  // pięć zmiennych o wykładnikach zajmujących 31 bitów nie mieści się
+  // w dwóch słowach
+  Poly deep = P(P(P(P(P(C(1), 1 << 30), 1), 1), 1), 1);
+  res &= PolyDistFromPoly(&deep) == NULL;
+  PolyDestroy(&deep);
+  return res;
+}
+
+/**
+ * Sprawdza, czy `PolyMul` daje ten sam iloczyn co mnożenie w postaci
+ * rozłożonej.
+ */
+static bool MulMatchesDist(const Poly *p, const Poly *q) {
+  Poly prod = PolyMul(p, q);
+  PolyDist *dp = PolyDistFromPoly(p);
+  PolyDist *dq = PolyDistFromPoly(q);
+  PolyDist *dprod = PolyDistMul(dp, dq);
+  Poly expected = PolyDistToPoly(dprod);
+  bool res = PolyIsEq(&prod, &expected);
+  PolyDestroy(&prod);
+  PolyDestroy(&expected);
+  PolyDistDestroy(dp);
+  PolyDistDestroy(dq);
+  PolyDistDestroy(dprod);
+  return res;
+}
+
+/**
+ * Sprawdza mnożenie wielomianów, których iloczyny jednomianów często mają
+ * ten sam wykładnik, porównując wynik z iloczynem w postaci rozłożonej.
+ * Sprawdza też iloczyn, w którym prawie wszystkie jednomiany się redukują.
+ */
+static bool MulCollisionTest(void) {
+  bool res = true;
+  const size_t n = 40;
+  Mono p_monos[n], q_monos[n], r_monos[n];
+  for (size_t i = 0; i < n; ++i) {
+    p_monos[i] = M(i % 3 == 0 ? P(C(1), 0, C((poly_coeff_t)i + 1), 1)
+                              : C((poly_coeff_t)i + 1), (poly_exp_t)i);
+    q_monos[i] = M(C(i % 2 == 0 ? 1 : -1), (poly_exp_t)(2 * i));
+    r_monos[i] = M(C(1), (poly_exp_t)i);
+  }
+  Poly p = PolyAddMonos(n, p_monos);
+  Poly q = PolyAddMonos(n, q_monos);
+  Poly r = PolyAddMonos(n, r_monos);
+  res &= MulMatchesDist(&p, &q);
+
+  // (1 + x + ... + x^39)(1 - x) = 1 - x^40
+  Poly one_minus = P(C(1), 0, C(-1), 1);
+  Poly tele = PolyMul(&r, &one_minus);
+  Poly tele_expected = P(C(1), 0, C(-1), 40);
+  res &= PolyIsEq(&tele, &tele_expected);
+  Poly square = PolyMul(&r, &r);
+  res &= PolyDeg(&square) == 78 && square.size == 79;
+  for (poly_coeff_t x = -1; x <= 1; ++x) {
+    poly_coeff_t rx = PolyEval(&r, 1, &x);
+    res &= PolyEval(&square, 1, &x) == rx * rx;
+  }
+  PolyDestroy(&one_minus);
+  PolyDestroy(&tele);
+  PolyDestroy(&tele_expected);
+  PolyDestroy(&square);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&r);
+  return res;
+}
+
+/**
+ * Tworzy wielomian jednej zmiennej o stałych współczynnikach, w którym
+ * co siódmy wykładnik z przedziału jest pominięty.
+ */
+static Poly DenseUnivariate(size_t n, poly_exp_t min_exp,
+                            unsigned long seed) {
+  Mono *monos = calloc(n, sizeof(Mono));
+  CHECK_PTR(monos);
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    seed = seed * 1103515245 + 12345;
+    poly_coeff_t c = (poly_coeff_t)(seed % 1999) - 999;
+    if (i % 7 != 3)
+      monos[count++] = M(C(c == 0 ? 1 : c), min_exp + (poly_exp_t)i);
+  }
+  Poly p = PolyAddMonos(count, monos);
+  free(monos);
+  return p;
+}
+
+/**
+ * Sprawdza mnożenie gęstych wielomianów jednej zmiennej o stałych
+ * współczynnikach, o długościach mniejszych i większych od progu algorytmu
+ * Karacuby, porównując wynik z iloczynem w postaci rozłożonej.
+ */
+static bool DenseMulTest(void) {
+  bool res = true;
+  const size_t sizes[][2] = {
+    {16, 16}, {23, 40}, {24, 24}, {25, 25}, {64, 64}, {100, 37},
+    {37, 300}, {257, 255}, {1000, 999},
+  };
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i) {
+    Poly p = DenseUnivariate(sizes[i][0], (poly_exp_t)i, 7 * i + 1);
+    Poly q = DenseUnivariate(sizes[i][1], 3, 11 * i + 5);
+    res &= MulMatchesDist(&p, &q);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+  }
+  return res;
+}
+
+/**
+ * Sprawdza mnożenie długich gęstych wielomianów jednej zmiennej, liczone
+ * za pomocą NTT, porównując wartości iloczynu w kilku punktach z iloczynami
+ * wartości czynników (modulo @f$2^{64}@f$). Drugi przypadek ma
+ * współczynniki bliskie granicom zakresu typu `poly_coeff_t`.
+ */
+static bool NttMulTest(void) {
+  bool res = true;
+  const size_t n = 17000, m = 20000;
+  Poly p = DenseUnivariate(n, 0, 1);
+  Poly q = DenseUnivariate(m, 5, 2);
+  Mono *monos = calloc(n, sizeof(Mono));
+  CHECK_PTR(monos);
+  for (size_t i = 0; i < n; ++i)
+    monos[i] = M(C(i % 2 == 0 ? LONG_MAX - (poly_coeff_t)i
+                              : LONG_MIN + (poly_coeff_t)i), (poly_exp_t)i);
+  Poly big = PolyAddMonos(n, monos);
+  free(monos);
+
+  Poly prods[] = {PolyMul(&p, &q), PolyMul(&big, &q)};
+  const Poly *factors[][2] = {{&p, &q}, {&big, &q}};
+  const poly_coeff_t points[] = {-2, -1, 0, 1, 3, 1000003};
+  for (size_t k = 0; k < 2; ++k) {
+    for (size_t i = 0; i < sizeof points / sizeof points[0]; ++i) {
+      unsigned long a = (unsigned long)PolyEval(factors[k][0], 1, &points[i]);
+      unsigned long b = (unsigned long)PolyEval(factors[k][1], 1, &points[i]);
+      res &= (unsigned long)PolyEval(&prods[k], 1, &points[i]) == a * b;
+    }
+    res &= PolyDeg(&prods[k]) ==
+           PolyDeg(factors[k][0]) + PolyDeg(factors[k][1]);
+    PolyDestroy(&prods[k]);
+  }
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&big);
+  return res;
+}
+
+/**
+ * Tworzy gęsty wielomian trzech zmiennych o wykładnikach mniejszych niż
+ * @p n przy każdej zmiennej, z których najmniejszy jest równy @p min_exp .
+ */
+static Poly DenseTrivariate(size_t n, poly_exp_t min_exp, poly_coeff_t sign) {
+  Mono outer[n];
+  for (size_t i = 0; i < n; ++i) {
+    Mono middle[n];
+    for (size_t j = 0; j < n; ++j) {
+      Mono inner[n];
+      for (size_t k = 0; k < n; ++k)
+        inner[k] = M(C(sign * (poly_coeff_t)(i + 2 * j + 3 * k + 1)),
+                     min_exp + (poly_exp_t)k);
+      middle[j] = M(PolyAddMonos(n, inner), (poly_exp_t)j);
+    }
+    outer[i] = M(PolyAddMonos(n, middle), (poly_exp_t)i);
+  }
+  return PolyAddMonos(n, outer);
+}
+
+/**
+ * Sprawdza mnożenie wielomianów wielu zmiennych za pomocą podstawienia
+ * Kroneckera, porównując wynik z iloczynem w postaci rozłożonej, oraz
+ * mnożenie, w którym wykładniki po podstawieniu nie mieszczą się w typie
+ * `poly_exp_t`.
+ */
+static bool KroneckerTest(void) {
+  bool res = true;
+  Poly p = DenseTrivariate(4, 0, 1);
+  Poly q = DenseTrivariate(5, 2, -1);
+  res &= MulMatchesDist(&p, &q);
+
+  // (x_1^{2^29} + x_0)(x_1^{2^29} - x_0) = x_1^{2^30} - x_0^2
+  Poly a = P(P(C(1), 1 << 29), 0, C(1), 1);
+  Poly b = P(P(C(1), 1 << 29), 0, C(-1), 1);
+  Poly ab = PolyMul(&a, &b);
+  Poly ab_expected = P(P(C(1), 1 << 30), 0, C(-1), 2);
+  res &= PolyIsEq(&ab, &ab_expected);
+  PolyDestroy(&a);
+  PolyDestroy(&b);
+  PolyDestroy(&ab);
+  PolyDestroy(&ab_expected);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  return res;
+}
+
+/**
+ * Sprawdza, czy równe wielomiany mają równe skróty, również po modyfikacji
+ * wielomianu, której wynik jest równy innemu wielomianowi, oraz czy
+ * porównanie wielomianów o różnych skrótach daje fałsz.
+ */
+static bool HashTest(void) {
+  bool res = true;
+  Poly p = P(P(C(1), 0, C(2), 3), 0, C(3), 2, P(C(-1), 1), 5);
+  Poly q = P(P(C(1), 0, C(2), 3), 0, C(3), 2, P(C(-1), 1), 5);
+  Poly r = P(P(C(1), 0, C(2), 3), 0, C(3), 2, P(C(-2), 1), 5);
+  Poly clone = PolyClone(&p);
+  res &= PolyHash(&p) == PolyHash(&q) && PolyHash(&p) == PolyHash(&clone);
+  res &= PolyHash(&p) != PolyHash(&r) && !PolyIsEq(&p, &r);
+  Poly c1 = C(5), c2 = C(5);
+  res &= PolyHash(&c1) == PolyHash(&c2);
+
+  // p - x_0^5 x_1 = r - 2 x_0^5 x_1
+  Poly a = P(P(C(-1), 1), 5);
+  Poly b = P(P(C(-2), 1), 5);
+  PolySubAssign(&p, &a);
+  PolySubAssign(&r, &b);
+  res &= PolyHash(&p) == PolyHash(&r) && PolyIsEq(&p, &r);
+  res &= PolyHash(&clone) == PolyHash(&q) && !PolyIsEq(&p, &clone);
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&r);
+  PolyDestroy(&clone);
+  return res;
+}
+
+/**
+ * Sprawdza, czy wielomian jednej zmiennej o wykładnikach mniejszych niż
+ * @p range ma współczynniki @p coeffs .
+ */
+static bool HasCoeffs(const Poly *p, const poly_coeff_t coeffs[],
+                      size_t range) {
+  size_t k = 0;
+  for (size_t e = range; e-- > 0;) {
+    if (coeffs[e] == 0)
+      continue;
+    if (PolyIsCoeff(p))
+      return e == 0 && k == 0 && p->coeff == coeffs[0];
+    if (k >= p->size || p->arr[k].exp != (poly_exp_t)e ||
+        !PolyIsCoeff(&p->arr[k].p) || p->arr[k].p.coeff != coeffs[e])
+      return false;
+    ++k;
+  }
+  return PolyIsCoeff(p) ? PolyIsZero(p) && k == 0 : k == p->size;
+}
+
+/**
+ * Sprawdza sortowanie jednomianów w funkcji `PolyAddMonos` dla tablic
+ * posortowanych, odwróconych, złożonych z kilku serii oraz losowych,
+ * krótkich i długich, z powtarzającymi się wykładnikami.
+ */
+static bool SortMonosTest(void) {
+  bool res = true;
+  const size_t sizes[] = {1, 2, 5, 40, 1000, 20000};
+  for (size_t s = 0; s < sizeof sizes / sizeof sizes[0]; ++s) {
+    size_t n = sizes[s];
+    Mono *monos = calloc(n, sizeof(Mono));
+    poly_coeff_t *coeffs = calloc(2 * n, sizeof(poly_coeff_t));
+    CHECK_PTR(monos);
+    CHECK_PTR(coeffs);
+    for (int pattern = 0; pattern < 5; ++pattern) {
+      unsigned long seed = 12345 + n;
+      for (size_t i = 0; i < 2 * n; ++i)
+        coeffs[i] = 0;
+      for (size_t i = 0; i < n; ++i) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        size_t e;
+        switch (pattern) {
+          case 0: e = 2 * (n - i) - 1; break;         // malejąco
+          case 1: e = i; break;                       // rosnąco
+          case 2: e = (i % (n / 4 + 1)) * 2; break;   // kilka serii
+          case 3: e = (seed >> 33) % (2 * n); break;  // losowo
+          default: e = (seed >> 33) % 4 % (2 * n); break;  // powtórzenia
+        }
+        poly_coeff_t c = (i % 2 ? -1 : 1) * (poly_coeff_t)(i % 7 + 1);
+        monos[i] = M(C(c), (poly_exp_t)e);
+        coeffs[e] += c;
+      }
+      Poly p = PolyAddMonos(n, monos);
+      res &= HasCoeffs(&p, coeffs, 2 * n);
+      PolyDestroy(&p);
+    }
+    free(monos);
+    free(coeffs);
+  }
+  return res;
+}
+
+/**
+ * Sprawdza budowanie wielomianów z wyrazów o wektorach wykładników i z wielu
+ * jednomianów o powtarzających się wykładnikach, porównując wynik z funkcją
+ * `PolyAddMonos`, oraz przerwanie budowania.
+ */
+static bool BuilderTest(void) {
+  bool res = true;
+  // 3 + 2 x_0 x_1^2 - x_0 x_1^2 + 5 x_1 x_2^3 + 7 x_0^4
+  PolyBuilder *b = PolyBuilderBegin();
+  PolyBuilderAddTerm(b, 0, NULL, 3);
+  PolyBuilderAddTerm(b, 2, (poly_exp_t[]){1, 2}, 2);
+  PolyBuilderAddTerm(b, 3, (poly_exp_t[]){0, 1, 3}, 5);
+  PolyBuilderAddTerm(b, 2, (poly_exp_t[]){1, 2}, -1);
+  PolyBuilderAddTerm(b, 1, (poly_exp_t[]){4}, 7);
+  PolyBuilderAddTerm(b, 2, (poly_exp_t[]){3, 3}, 0);
+  Poly built = PolyBuilderFinish(b);
+  Poly expected = P(P(C(3), 0, P(C(5), 3), 1), 0, P(C(1), 2), 1, C(7), 4);
+  res &= PolyIsEq(&built, &expected);
+  PolyDestroy(&built);
+  PolyDestroy(&expected);
+
+  const size_t n = 5000;
+  Mono *monos = calloc(n, sizeof(Mono));
+  CHECK_PTR(monos);
+  b = PolyBuilderBegin();
+  for (size_t i = 0; i < n; ++i) {
+    poly_coeff_t c = (i % 3 ? 1 : -2) * (poly_coeff_t)(i % 5 + 1);
+    poly_exp_t e = (poly_exp_t)(i * 37 % 701);
+    monos[i] = M(P(C(c), (poly_exp_t)(i % 4)), e);
+    Mono m = M(P(C(c), (poly_exp_t)(i % 4)), e);
+    PolyBuilderAddMono(b, &m);
+  }
+  built = PolyBuilderFinish(b);
+  expected = PolyAddMonos(n, monos);
+  res &= PolyIsEq(&built, &expected);
+  PolyDestroy(&built);
+  PolyDestroy(&expected);
+  free(monos);
+
+  // wykładniki rosnące, malejące, skracające się i monotoniczne do czasu
+  for (int order = 0; order < 4; ++order) {
+    b = PolyBuilderBegin();
+    expected = PolyZero();
+    for (poly_exp_t i = 0; i < 300; ++i) {
+      poly_exp_t e = order == 1 ? 300 - i : i;
+      if (order == 3 && i == 250)
+        e = 17;
+      Mono m = M(C(i + 1), e);
+      Poly q = P(C(i + 1), e);
+      PolyAddAssign(&expected, &q);
+      PolyBuilderAddMono(b, &m);
+      if (order == 2) {
+        m = M(C(-i - 1), e);
+        q = P(C(-i - 1), e);
+        PolyAddAssign(&expected, &q);
+        PolyBuilderAddMono(b, &m);
+      }
+    }
+    built = PolyBuilderFinish(b);
+    res &= PolyIsEq(&built, &expected);
+    res &= order != 2 || PolyIsZero(&built);
+    PolyDestroy(&built);
+    PolyDestroy(&expected);
+  }
+
+  b = PolyBuilderBegin();
+  built = PolyBuilderFinish(b);
+  res &= PolyIsZero(&built);
+
+  b = PolyBuilderBegin();
+  for (size_t i = 0; i < 200; ++i) {
+    Mono m = M(P(C(1), 1), (poly_exp_t)i);
+    PolyBuilderAddMono(b, &m);
+  }
+  PolyBuilderDestroy(b);
+  return res;
+}
+
+/**
+ * Sprawdza funkcję `ParsePolyLine`: poprawne literały muszą dać ten sam
+ * wielomian co `ParsePoly`, a niepoprawne, w tym współczynniki i wykładniki
+ * spoza zakresu, muszą zostać odrzucone. Sprawdza też, że brana jest pod
+ * uwagę tylko podana długość linii oraz że głębokie zagnieżdżenie nie
+ * przepełnia stosu.
+ */
+static bool ParserTest(void) {
+  bool res = true;
+  const char *valid[] = {
+    "0", "-0", "007", "9223372036854775807", "-9223372036854775808",
+    "(1,2)", "(-3,0)+(1,2)+(5,2)", "((1,2)+(3,0),4)+(2,2147483647)",
+    "(1,3)+(-1,3)", "(0,5)+(0,1)", "(1,2)+(1,1)+(1,0)+(1,1)",
+    "-00000000000000000000000000000000000000009223372036854775808",
+    "(12345678,87654321)+(-1234567890123456789,00000000000000002147483647)"
+  };
+  for (size_t i = 0; i < sizeof valid / sizeof valid[0]; ++i) {
+    char *end;
+    Poly p, q;
+    res &= ParsePolyLine(valid[i], strlen(valid[i]), &p);
+    res &= ParsePoly((char *)valid[i], &end, &q) && *end == '\0';
+    res &= PolyIsEq(&p, &q);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+  }
+
+  const char *invalid[] = {
+    "", "+1", "--1", "-", "1-", "9223372036854775808",
+    "-9223372036854775809", "(1,2", "(1,2))", "(1,-2)", "(1,+2)",
+    "(1,2147483648)", "(1,4294967296)", "(1,2)+", "(1,2)+1", "(1,2)(1,2)",
+    "((1,2),3", "(1,2),3", "(1 ,2)", "(1,2)x", "1(", "()", "(,1)", "(1,)",
+    "0000000000000000000000000000000000000000009223372036854775808",
+    "(1,000000000000000000000000000000000000000002147483648)",
+    "(1,2)+(1,99999999999999999999999999999999999999999999999)"
+  };
+  for (size_t i = 0; i < sizeof invalid / sizeof invalid[0]; ++i) {
+    Poly p;
+    res &= !ParsePolyLine(invalid[i], strlen(invalid[i]), &p);
+  }
+
+  Poly p;
+  res &= !ParsePolyLine("(1,2)\0", 6, &p);
+  res &= ParsePolyLine("(1,2)\0", 5, &p);
+  Poly expected = P(C(1), 2);
+  res &= PolyIsEq(&p, &expected);
+  PolyDestroy(&p);
+  PolyDestroy(&expected);
+
+  // zagnieżdżenie głębsze niż bezpieczna głębokość rekurencji
+  const size_t depth = 100000;
+  char *s = malloc(5 * depth + 2);
+  CHECK_PTR(s);
+  memset(s, '(', depth);
+  s[depth] = '1';
+  for (size_t i = 0; i < depth; ++i)
+    memcpy(s + depth + 1 + 3 * i, ",0)", 3);
+  res &= ParsePolyLine(s, 4 * depth + 1, &p);
+  res &= PolyIsCoeff(&p) && p.coeff == 1;
+  PolyDestroy(&p);
+  s[4 * depth] = '(';
+  res &= !ParsePolyLine(s, 4 * depth + 1, &p);
+  free(s);
+  return res;
+}
+
+/** Oblicza stopień wielomianu, przechodząc cały wielomian. */
+static poly_exp_t TraversalDeg(const Poly *p) {
+  if (PolyIsCoeff(p))
+    return PolyIsZero(p) ? -1 : 0;
+  poly_exp_t deg = 0;
+  for (size_t i = 0; i < p->size; ++i) {
+    poly_exp_t d = TraversalDeg(&p->arr[i].p) + p->arr[i].exp;
+    deg = d > deg ? d : deg;
+  }
+  return deg;
+}
+
+/** Oblicza stopień ze względu na zmienną, przechodząc cały wielomian. */
+static poly_exp_t TraversalDegBy(const Poly *p, size_t var_idx) {
+  if (PolyIsCoeff(p))
+    return PolyIsZero(p) ? -1 : 0;
+  if (var_idx == 0)
+    return p->arr[0].exp;
+  poly_exp_t deg = 0;
+  for (size_t i = 0; i < p->size; ++i) {
+    poly_exp_t d = TraversalDegBy(&p->arr[i].p, var_idx - 1);
+    deg = d > deg ? d : deg;
+  }
+  return deg;
+}
+
+/** Porównuje zapamiętane stopnie wielomianu ze stopniami obliczonymi. */
+static bool CheckDegs(const Poly *p) {
+  bool res = PolyDeg(p) == TraversalDeg(p);
+  for (size_t i = 0; i < 5; ++i)
+    res &= PolyDegBy(p, i) == TraversalDegBy(p, i);
+  return res;
+}
+
+/**
+ * Sprawdza stopnie zapamiętywane przy tworzeniu wielomianów, m.in. po
+ * skróceniu się wyrazów najwyższego stopnia, po podstawieniu wartości
+ * i po skopiowaniu wielomianu bez współdzielenia tablic.
+ */
+static bool DegCacheTest(void) {
+  bool res = true;
+  Poly p = P(P(C(1), 0, C(2), 3), 0, C(3), 2, P(P(C(-1), 4), 1), 5);
+  Poly q = P(P(C(1), 0, C(1), 3), 0, P(P(C(1), 4), 1), 5);
+  res &= CheckDegs(&p) && CheckDegs(&q);
+
+  Poly sum = PolyAdd(&p, &q);
+  res &= CheckDegs(&sum) && PolyDeg(&sum) == 3 && PolyDegBy(&sum, 2) == 0;
+  Poly prod = PolyMul(&p, &q);
+  res &= CheckDegs(&prod) && PolyDeg(&prod) == 20;
+  Poly at = PolyAt(&prod, 2);
+  res &= CheckDegs(&at);
+  Poly composed = PolyCompose(&p, 1, &q);
+  res &= CheckDegs(&composed);
+
+  PolySetSharing(false);
+  Poly clone = PolyClone(&prod);
+  PolySetSharing(true);
+  res &= CheckDegs(&clone);
+
+  PolyAddAssign(&clone, &sum);
+  res &= CheckDegs(&clone);
+  Poly neg = PolyNeg(&clone);
+  PolyAddAssign(&clone, &neg);
+  res &= CheckDegs(&clone) && PolyDeg(&clone) == -1;
+
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyDestroy(&prod);
+  PolyDestroy(&at);
+  PolyDestroy(&composed);
+  return res;
+}
+
+/**
+ * Sprawdza, czy mnożenie na wielu wątkach daje te same wyniki co mnożenie
+ * sekwencyjne, dla czynników mnożonych różnymi metodami.
+ */
+static bool ParallelMulTest(void) {
+  bool res = true;
+  Mono sparse[2][300];
+  for (size_t k = 0; k < 2; ++k)
+    for (size_t i = 0; i < 300; ++i)
+      sparse[k][i] = M(C((poly_coeff_t)(i + k + 1)),
+                       (poly_exp_t)(i * (i + k + 1)));
+  Poly factors[][2] = {
+    {DenseTrivariate(8, 0, 1), DenseTrivariate(9, 1, -1)},
+    {DenseUnivariate(300, 0, 3), DenseUnivariate(400, 2, 4)},
+    {PolyAddMonos(300, sparse[0]), PolyAddMonos(300, sparse[1])},
+  };
+
+  for (size_t k = 0; k < sizeof factors / sizeof factors[0]; ++k) {
+    PolySetThreads(1);
+    Poly expected = PolyMul(&factors[k][0], &factors[k][1]);
+    PolySetThreads(4);
+    Poly prod = PolyMul(&factors[k][0], &factors[k][1]);
+    Poly swapped = PolyMul(&factors[k][1], &factors[k][0]);
+    res &= PolyIsEq(&prod, &expected) && PolyIsEq(&swapped, &expected);
+    PolyDestroy(&expected);
+    PolyDestroy(&prod);
+    PolyDestroy(&swapped);
+    PolyDestroy(&factors[k][0]);
+    PolyDestroy(&factors[k][1]);
+  }
+  PolySetThreads(1);
+  return res;
+}
+
+/** Sumuje indeksy zadań wewnętrznych w teście `WorkStealingTest`. */
+static void InnerSumTask(void *arg, size_t i) {
+  atomic_size_t *sum = arg;
+  atomic_fetch_add(sum, i);
+}
+
+/** Zleca zadania wewnętrzne w teście `WorkStealingTest`. */
+static void OuterSumTask(void *arg, size_t i) {
+  PolyParallelFor(100 + i, InnerSumTask, arg);
+}
+
+/**
+ * Sprawdza, czy zadania zlecane z wnętrza innych zadań wykonują się
+ * dokładnie raz.
+ */
+static bool WorkStealingTest(void) {
+  atomic_size_t sum = 0;
+  size_t expected = 0;
+  for (size_t i = 0; i < 16; ++i)
+    expected += (100 + i) * (99 + i) / 2;
+  PolySetThreads(4);
+  PolyParallelFor(16, OuterSumTask, &sum);
+  PolySetThreads(1);
+  return atomic_load(&sum) == expected;
+}
+
+/**
+ * Sprawdza, czy złożenie wielomianów na wielu wątkach daje te same wyniki co
+ * złożenie sekwencyjne.
+ */
+static bool ParallelComposeTest(void) {
+  bool res = true;
+  Poly p[] = {DenseTrivariate(5, 0, 1), DenseUnivariate(200, 0, 5)};
+  Poly q[] = {
+    P(C(1), 0, P(C(1), 1), 1),
+    P(C(2), 0, C(-1), 2),
+    P(P(C(1), 2), 1),
+  };
+  const size_t k[] = {3, 1};
+  for (size_t i = 0; i < sizeof p / sizeof p[0]; ++i) {
+    PolySetThreads(1);
+    Poly expected = PolyCompose(&p[i], k[i], q);
+    PolySetThreads(4);
+    Poly composed = PolyCompose(&p[i], k[i], q);
+    res &= PolyIsEq(&composed, &expected);
+    PolyDestroy(&expected);
+    PolyDestroy(&composed);
+    PolyDestroy(&p[i]);
+  }
+  PolySetThreads(1);
+  for (size_t i = 0; i < sizeof q / sizeof q[0]; ++i)
+    PolyDestroy(&q[i]);
+  return res;
+}
+
+/**
+ * Mierzy czas tworzenia wielomianu z posortowanych tablic jednomianów,
+ * w których prawie wszystkie jednomiany się skracają, dla rosnących
+ * rozmiarów tablicy. Tablice są posortowane, więc mierzony jest koszt
+ * upraszczania, a nie sortowania. Wypisuje czas na jednomian na standardowe
+ * wyjście błędów; przy liniowym upraszczaniu nie rośnie on z rozmiarem.
+ * Sprawdzana jest tylko poprawność wyniku.
+ */
+static bool CancellationBenchmark(void) {
+  bool res = true;
+  for (size_t n = (size_t)1 << 15; n <= (size_t)1 << 18; n *= 2) {
+    // jednomian, który się nie skraca, i pary jednomianów o przeciwnych
+    // współczynnikach, o nierosnących wykładnikach
+    Mono *monos = calloc(n + 1, sizeof(Mono));
+    CHECK_PTR(monos);
+    monos[0] = M(C(1), (poly_exp_t)n);
+    for (size_t i = 0; i < n; ++i) {
+      poly_coeff_t c = (poly_coeff_t)(i / 2 % 5 + 1);
+      monos[i + 1] = M(C(i % 2 ? -c : c), (poly_exp_t)(n / 2 - 1 - i / 2));
+    }
+    Poly expected = P(C(1), (poly_exp_t)n);
+    clock_t best = 0;
+    for (int rep = 0; rep < 5; ++rep) {
+      clock_t start = clock();
+      Poly p = PolyAddMonos(n + 1, monos);
+      clock_t time = clock() - start;
+      best = rep == 0 || time < best ? time : best;
+      res &= PolyIsEq(&p, &expected);
+      PolyDestroy(&p);
+    }
+    fprintf(stderr, "(n=%zu: %.1f ns/mono) ",
+            n, 1e9 * (double)best / CLOCKS_PER_SEC / (double)n);
+    PolyDestroy(&expected);
+    free(monos);
+  }
+  return res;
+}
+
+/**
+ * Mierzy przepustowość parsowania długiej linii przez funkcje `ParsePoly`
+ * i `ParsePolyLine`. Wypisuje ją w MB/s na standardowe wyjście błędów.
+ */
+static bool ParserBenchmark(void) {
+  const size_t n = (size_t)1 << 17;
+  char *s = malloc(64 * n);
+  CHECK_PTR(s);
+  size_t len = 0;
+  for (size_t i = 0; i < n; ++i) {
+    len += (size_t)sprintf(s + len, "%s((%ld,%zu)+(-%zu,%zu),%zu)",
+                           i > 0 ? "+" : "", 123456789L * (long)i,
+                           i % 7, i, i % 7 + 9, i);
+  }
+
+  bool res = true;
+  char *end;
+  Poly p, q;
+  clock_t start = clock();
+  res &= ParsePoly(s, &end, &p) && *end == '\0';
+  clock_t recursive_time = clock() - start;
+  start = clock();
+  res &= ParsePolyLine(s, len, &q);
+  clock_t line_time = clock() - start;
+  res &= PolyIsEq(&p, &q);
+  fprintf(stderr, "(%.1f MB, ParsePoly: %.0f MB/s, ParsePolyLine: %.0f MB/s) ",
+          (double)len / 1e6,
+          (double)len / 1e6 / ((double)recursive_time / CLOCKS_PER_SEC),
+          (double)len / 1e6 / ((double)line_time / CLOCKS_PER_SEC));
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  free(s);
+  return res;
+}
+
 /** GRUPY TESTÓW **/
 
 static bool SimpleNegGroup(void) {
@@ -4047,6 +4978,27 @@ static const test_list_t test_list[] = {
   TEST(MemoryThiefTest),
   TEST(MemoryFreeTest),
   TEST(MemoryGroup),
+  TEST(AssignTest),
+  TEST(EvalTest),
+  TEST(EvalBatchTest),
+  TEST(ProgramTest),
+  TEST(ComposeTest),
+  TEST(SharingTest),
+  TEST(DistTest),
+  TEST(MulCollisionTest),
+  TEST(DenseMulTest),
+  TEST(NttMulTest),
+  TEST(KroneckerTest),
+  TEST(HashTest),
+  TEST(DegCacheTest),
+  TEST(SortMonosTest),
+  TEST(BuilderTest),
+  TEST(ParserTest),
+  TEST(ParallelMulTest),
+  TEST(WorkStealingTest),
+  TEST(ParallelComposeTest),
+  TEST(CancellationBenchmark),
+  TEST(ParserBenchmark),
 };
 
 int main() {
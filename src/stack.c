@@ -60,6 +60,29 @@ void Pop(PolyStack *s) {
     s->top--;
 }
 
+/**
+ * Usuwa ze szczytu stosu @p count wielomianów i umieszcza na nim wynik
+ * operacji.
+ * @param s : stos wielomianów
+ * @param count : liczba usuwanych wielomianów
+ * @param res : wynik operacji
+ */
+static void ReplaceTop(PolyStack *s, size_t count, Poly res) {
+    for (size_t i = 0; i < count; i++) {
+        Pop(s);
+    }
+    Push(s, res);
+}
+
+/**
+ * Zdejmuje wielomian ze szczytu stosu bez zwalniania go z pamięci.
+ * @param s : stos wielomianów
+ * @return wielomian zdjęty ze szczytu stosu
+ */
+static Poly TakeTop(PolyStack *s) {
+    return s->arr[s->top--];
+}
+
 void FreeStack(PolyStack *s) {
     while (!IsEmpty(s)) {
         Pop(s);
@@ -121,30 +144,24 @@ void Clone(PolyStack *s) {
 }
 
 void Add(PolyStack *s) {
-    Poly res = PolyAdd(Top(s), &s->arr[s->top-1]);
-    Pop(s);
-    Pop(s);
-    Push(s, res);
+    Poly p = TakeTop(s);
+    PolyAddAssign(Top(s), &p);
 }
 
 void Mul(PolyStack *s) {
-    Poly res = PolyMul(Top(s), &s->arr[s->top-1]);
-    Pop(s);
-    Pop(s);
-    Push(s, res);
+    Poly p = TakeTop(s);
+    PolyMulAssign(Top(s), &p);
 }
 
 void Neg(PolyStack *s) {
-    Poly res = PolyNeg(Top(s));
-    Pop(s);
-    Push(s, res);
+    ReplaceTop(s, 1, PolyNeg(Top(s)));
 }
 
 void Sub(PolyStack *s) {
-    Poly res = PolySub(Top(s), &s->arr[s->top-1]);
-    Pop(s);
-    Pop(s);
-    Push(s, res);
+    Poly p = TakeTop(s);
+    Poly q = TakeTop(s);
+    PolySubAssign(&p, &q);
+    Push(s, p);
 }
 
 void IsEq(PolyStack *s) {
@@ -163,29 +180,15 @@ void DegBy(PolyStack *s, size_t var_idx) {
 }
 
 void At(PolyStack *s, poly_coeff_t x) {
-    Poly res = PolyAt(Top(s), x);
-    Pop(s);
-    Push(s, res);
+    ReplaceTop(s, 1, PolyAt(Top(s), x));
 }
 
-void Compose(PolyStack *s, size_t k) {
-    Poly p = PolyClone(Top(s));
-    Pop(s);
-
-    // tworzenie tablicy wielomianów
-    Poly *arr = (Poly*) calloc(k, sizeof(Poly));
-    CheckPtr(arr);
-    for (size_t i = 0; i < k; i++) {
-        arr[k-i-1] = PolyClone(Top(s));
-        Pop(s);
-    }
-    
-    Push(s, PolyCompose(&p, k, arr));
+void Eval(PolyStack *s, size_t k, const poly_coeff_t x[]) {
+    ReplaceTop(s, 1, PolyFromCoeff(PolyEval(Top(s), k, x)));
+}
 
-    // zwalnianie tablicy wielomianów
-    for (size_t i = 0; i < k; i++) {
-        PolyDestroy(&arr[i]);
-    }
-    free(arr);
-    PolyDestroy(&p);
+void Compose(PolyStack *s, size_t k) {
+    // wielomiany q_0, ..., q_{k-1} leżą na stosie bezpośrednio pod p
+    Poly res = PolyCompose(Top(s), k, &s->arr[s->top - k]);
+    ReplaceTop(s, k + 1, res);
 }
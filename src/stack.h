@@ -157,6 +157,16 @@ void DegBy(PolyStack *s, size_t var_idx);
  */
 void At(PolyStack *s, poly_coeff_t x);
 
+/**
+ * Zastępuje wielomian @f$p@f$ znajdujący się na szczycie stosu jego wartością
+ * w punkcie @f$(x_0, \ldots, x_{k-1})@f$, gdzie pod pozostałe zmienne
+ * podstawiane są zera.
+ * @param[in] s : wskaźnik na stos wielomianów
+ * @param[in] k : liczba wartości
+ * @param[in] x : tablica wartości @f$x_i@f$
+ */
+void Eval(PolyStack *s, size_t k, const poly_coeff_t x[]);
+
 /**
  * Zdejmuje z wierzchołka sostu wielomian @f$p@f$, a następnie kolejno
  * @f$k@f$ wielomianów @f$q_{k-1}, \ldots, q_0@f$ i umieszcza na stosie wynik